@@ -0,0 +1,223 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Control.cpp
+** Local control pipe for scripted, batched window operations.
+**
+** Automation that moves dozens of windows used to need one round trip per
+** window. Instead, a client sends a whole batch in a single pipe message and
+** we apply every geometry change in one BeginDeferWindowPos() transaction,
+** so the desktop repaints once instead of once per window.
+*/
+
+#include "stdafx.h"
+#include "ControlProtocol.h"
+#include "Control.h"
+
+static const DWORD REQUEST_SIZE =
+	sizeof(ControlHeader) + CONTROL_MAX_COMMANDS * sizeof(ControlCommand);
+static const DWORD REPLY_SIZE =
+	sizeof(ControlHeader) + CONTROL_MAX_COMMANDS * sizeof(ControlResult);
+
+// Only the server thread touches these.
+static BYTE request[REQUEST_SIZE];
+static BYTE reply[REPLY_SIZE];
+static ControlReorderFn onReorder = NULL;
+
+static UINT GetPositionFlags(const ControlCommand *cmd)
+{
+	const UINT flags = SWP_NOACTIVATE | SWP_NOOWNERZORDER;
+	switch (cmd->op) {
+	case CONTROL_MOVE:
+		return flags | SWP_NOSIZE | SWP_NOZORDER;
+	case CONTROL_RESIZE:
+		return flags | SWP_NOMOVE | SWP_NOZORDER;
+	case CONTROL_SETRECT:
+		return flags | SWP_NOZORDER;
+	case CONTROL_SENDTOBACK:
+		return flags | SWP_NOMOVE | SWP_NOSIZE;
+	default:
+		return 0;
+	}
+}
+
+static HWND GetInsertAfter(const ControlCommand *cmd)
+{
+	return (cmd->op == CONTROL_SENDTOBACK) ? HWND_BOTTOM : NULL;
+}
+
+// Check a single command and work out what to do with it. Returns the status
+// to report. Commands that pass with a nonzero *flags get positioned.
+static DWORD ValidateCommand(const ControlCommand *cmd, UINT *flags)
+{
+	*flags = 0;
+	const HWND hwnd = (HWND)(ULONG_PTR)cmd->hwnd;
+	if (!IsWindow(hwnd))
+		return CONTROL_BAD_WINDOW;
+
+	if (cmd->op == CONTROL_QUERY)
+		return CONTROL_OK;
+
+	*flags = GetPositionFlags(cmd);
+	if (!*flags)
+		return CONTROL_BAD_OP;
+
+	// Everything in a deferred batch has to share a parent, and we only
+	// promise to arrange top-level windows anyway.
+	if (GetAncestor(hwnd, GA_PARENT) != GetDesktopWindow()) {
+		*flags = 0;
+		return CONTROL_BAD_OP;
+	}
+
+	// Positioning a minimized or maximized window just corrupts its restore
+	// rectangle. Sending it to the back is fine, though.
+	if (cmd->op != CONTROL_SENDTOBACK && (IsIconic(hwnd) || IsZoomed(hwnd))) {
+		*flags = 0;
+		return CONTROL_BAD_OP;
+	}
+	return CONTROL_OK;
+}
+
+// Applies every positioning command in one transaction. DeferWindowPos()
+// throws the whole transaction away when it fails (say, because a window went
+// away since we validated it), so in that case we start over from the first
+// command and apply them one at a time, noting any that still fail. These
+// wait for each window's thread, unlike the hooks, so that what we report is
+// where the window really ended up.
+static void PositionWindows(const ControlCommand *cmds, const UINT *flags,
+	int count, int positioned, ControlResult *results)
+{
+	HDWP dwp = BeginDeferWindowPos(positioned);
+	for (int i = 0; dwp && i < count; i++) {
+		if (flags[i]) {
+			const HWND hwnd = (HWND)(ULONG_PTR)cmds[i].hwnd;
+			dwp = DeferWindowPos(dwp, hwnd, GetInsertAfter(&cmds[i]),
+				cmds[i].x, cmds[i].y, cmds[i].cx, cmds[i].cy, flags[i]);
+		}
+	}
+	if (dwp && EndDeferWindowPos(dwp))
+		return;
+
+	for (int i = 0; i < count; i++) {
+		if (!flags[i])
+			continue;
+		const HWND hwnd = (HWND)(ULONG_PTR)cmds[i].hwnd;
+		if (!SetWindowPos(hwnd, GetInsertAfter(&cmds[i]), cmds[i].x, cmds[i].y,
+				cmds[i].cx, cmds[i].cy, flags[i]))
+			results[i].status = IsWindow(hwnd) ? CONTROL_BAD_OP : CONTROL_BAD_WINDOW;
+	}
+}
+
+// Apply a batch of commands and fill in the reply. Returns the reply size.
+static DWORD RunBatch(DWORD requestSize)
+{
+	const ControlHeader *header = (const ControlHeader *)request;
+	ControlHeader *replyHeader = (ControlHeader *)reply;
+	replyHeader->version = CONTROL_VERSION;
+	replyHeader->count = 0;
+	replyHeader->status = CONTROL_OK;
+
+	if (requestSize < sizeof(ControlHeader) || header->version != CONTROL_VERSION ||
+			header->count > CONTROL_MAX_COMMANDS ||
+			requestSize != sizeof(ControlHeader) + header->count * sizeof(ControlCommand)) {
+		replyHeader->status = CONTROL_BAD_REQUEST;
+		return sizeof(ControlHeader);
+	}
+
+	const int count = header->count;
+	const ControlCommand *cmds = (const ControlCommand *)(header + 1);
+	ControlResult *results = (ControlResult *)(replyHeader + 1);
+	UINT flags[CONTROL_MAX_COMMANDS];
+
+	int positioned = 0;
+	for (int i = 0; i < count; i++) {
+		results[i].status = ValidateCommand(&cmds[i], &flags[i]);
+		if (flags[i])
+			positioned++;
+	}
+
+	if (positioned > 0)
+		PositionWindows(cmds, flags, count, positioned, results);
+
+	// Nothing announces a window going to the back without anything being
+	// activated, so the hooks' window tables have to be told.
+	for (int i = 0; i < count; i++) {
+		if (flags[i] && GetInsertAfter(&cmds[i]) && onReorder) {
+			onReorder();
+			break;
+		}
+	}
+
+	// Report where everything ended up.
+	for (int i = 0; i < count; i++) {
+		const HWND hwnd = (HWND)(ULONG_PTR)cmds[i].hwnd;
+		if (results[i].status == CONTROL_BAD_WINDOW || !GetWindowRect(hwnd, &results[i].rect))
+			ZeroMemory(&results[i].rect, sizeof(RECT));
+	}
+
+	replyHeader->count = header->count;
+	return sizeof(ControlHeader) + count * sizeof(ControlResult);
+}
+
+// We insist on creating the pipe, not just another instance of it. Otherwise
+// a process that got there first would be handed the clients' window commands
+// (and another copy of Grapple would be serving them too). When the name is
+// taken, CreateNamedPipe() fails with ERROR_ACCESS_DENIED and we go without.
+static HANDLE CreateControlPipe(void)
+{
+	const DWORD access = PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE;
+	const DWORD mode = PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT;
+	HANDLE pipe = CreateNamedPipe(CONTROL_PIPE_NAME, access,
+		mode | PIPE_REJECT_REMOTE_CLIENTS, 1, REPLY_SIZE, REQUEST_SIZE, 0, NULL);
+
+	// XP doesn't know about PIPE_REJECT_REMOTE_CLIENTS.
+	if (pipe == INVALID_HANDLE_VALUE && GetLastError() == ERROR_INVALID_PARAMETER)
+		pipe = CreateNamedPipe(CONTROL_PIPE_NAME, access,
+			mode, 1, REPLY_SIZE, REQUEST_SIZE, 0, NULL);
+	return pipe;
+}
+
+// Serve one client at a time, one batch per message, until the client hangs up.
+static DWORD WINAPI ControlThreadProc(LPVOID param)
+{
+	HANDLE pipe = (HANDLE)param;
+	for (;;) {
+		if (!ConnectNamedPipe(pipe, NULL) && GetLastError() != ERROR_PIPE_CONNECTED) {
+			Sleep(100);
+			continue;
+		}
+
+		DWORD size;
+		while (ReadFile(pipe, request, REQUEST_SIZE, &size, NULL)) {
+			DWORD written;
+			const DWORD replySize = RunBatch(size);
+			if (!WriteFile(pipe, reply, replySize, &written, NULL))
+				break;
+		}
+
+		// A batch too big for our buffer shows up as ERROR_MORE_DATA. We
+		// can't make sense of half a batch, so drop the client.
+		DisconnectNamedPipe(pipe);
+	}
+	return 0;
+}
+
+bool StartControlServer(ControlReorderFn reorderFn)
+{
+	onReorder = reorderFn;
+	HANDLE pipe = CreateControlPipe();
+	if (pipe == INVALID_HANDLE_VALUE)
+		return false;
+
+	HANDLE thread = CreateThread(NULL, 0, ControlThreadProc, pipe, 0, NULL);
+	if (!thread) {
+		CloseHandle(pipe);
+		return false;
+	}
+	CloseHandle(thread);
+	return true;
+}
@@ -0,0 +1,20 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Control.h
+** Local control pipe for scripted, batched window operations.
+*/
+
+#pragma once
+
+typedef void (WINAPI *ControlReorderFn)(void);
+
+// Starts serving CONTROL_PIPE_NAME on a background thread. The thread lives
+// until the process exits. Returns false if the pipe is unavailable, e.g.
+// because some other process already created it. onReorder, if not NULL, is
+// called after a batch changes the z-order of any window.
+bool StartControlServer(ControlReorderFn onReorder);
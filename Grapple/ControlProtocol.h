@@ -0,0 +1,64 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** ControlProtocol.h
+** Wire format for Grapple's local control pipe. Scripts that want to move
+** windows around in bulk can include this header.
+**
+** A client writes one pipe message per batch: a ControlHeader followed by
+** header.count ControlCommands. Grapple applies every geometry change in the
+** batch at once, then replies with one pipe message: a ControlHeader with the
+** same count followed by one ControlResult per command, in the same order.
+** Each result carries the window's rectangle (in screen coordinates) after
+** the whole batch has been applied, so CONTROL_QUERY is just a command that
+** doesn't change anything. Only top-level windows can be moved, resized or
+** sent to the back; any other window gets CONTROL_BAD_OP.
+*/
+
+#pragma once
+
+#define CONTROL_PIPE_NAME TEXT("\\\\.\\pipe\\Grapple")
+
+static const WORD CONTROL_VERSION = 1;
+static const WORD CONTROL_MAX_COMMANDS = 256;
+
+enum ControlOp {
+	CONTROL_QUERY = 0,       // Report the window's rectangle.
+	CONTROL_MOVE = 1,        // Move the window to (x, y).
+	CONTROL_RESIZE = 2,      // Resize the window to (cx, cy).
+	CONTROL_SETRECT = 3,     // Move and resize. A batch of these applies a layout.
+	CONTROL_SENDTOBACK = 4   // Send the window to the bottom of the z-order.
+};
+
+enum ControlStatus {
+	CONTROL_OK = 0,
+	CONTROL_BAD_WINDOW = 1,  // The handle doesn't refer to a window.
+	CONTROL_BAD_OP = 2,      // Unknown op, or the window can't take it right now.
+	CONTROL_BAD_REQUEST = 3  // The request was malformed. Only used in reply headers.
+};
+
+#pragma pack(push, 4)
+
+struct ControlHeader {
+	WORD version;
+	WORD count;
+	DWORD status;            // Zero in requests.
+};
+
+struct ControlCommand {
+	DWORD op;
+	DWORD reserved;
+	ULONGLONG hwnd;          // Widened so 32- and 64-bit clients agree on layout.
+	LONG x, y, cx, cy;
+};
+
+struct ControlResult {
+	DWORD status;
+	RECT rect;
+};
+
+#pragma pack(pop)
@@ -0,0 +1,30 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Evdev.h
+** Record format of Linux evdev input recordings, which Grapple replays for
+** benchmarking.
+*/
+
+#pragma once
+
+// Layout of struct input_event on a 64-bit kernel.
+struct EvdevEvent {
+	LONGLONG sec;
+	LONGLONG usec;
+	WORD type;
+	WORD code;
+	LONG value;
+};
+
+static const WORD EV_SYN = 0x00;
+static const WORD EV_KEY = 0x01;
+static const WORD EV_REL = 0x02;
+static const WORD SYN_REPORT = 0;
+static const WORD REL_X = 0x00;
+static const WORD REL_Y = 0x01;
+static const WORD REL_WHEEL = 0x08;
@@ -0,0 +1,271 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Geometry.cpp
+** Remembers where each application's windows were last put.
+**
+** The table is a small open-addressed hash table in a memory-mapped file next
+** to the application, keyed by a 64-bit FNV-1a hash of the executable name and
+** the window class. Both recording and lookup touch at most MAX_PROBES slots
+** and never allocate, since we do a lookup for every top-level window that
+** shows up, and applications starting up create a lot of those.
+**
+** The table is mapped under a name (see GeometryTable.h) so that GrappleLib's
+** CBT hook can look a window up while it's being created, from inside the
+** application, and move it before it's ever shown. Here we listen with
+** out-of-context WinEvent hooks for the rest: recording where windows end
+** up, and when a new top-level window is first shown, maximizing it if it
+** was maximized last time, or placing it if the CBT hook couldn't (windows
+** of the other bitness, or of elevated processes).
+*/
+
+#include "stdafx.h"
+#include "Geometry.h"
+#include "../GrappleLib/GeometryTable.h"
+#include <psapi.h>
+
+#pragma comment(lib, "psapi.lib")
+
+#ifndef PROCESS_QUERY_LIMITED_INFORMATION
+#define PROCESS_QUERY_LIMITED_INFORMATION 0x1000
+#endif
+
+static const TCHAR *GEOMETRY_FILE = TEXT("GrappleGeometry.dat");
+
+// Windows created but not yet shown. Must be a power of two.
+static const int MAX_PENDING = 64;
+
+static HANDLE geometryFile = NULL;
+static HANDLE geometryMapping = NULL;
+static GeometryTable *table = NULL;
+static HWINEVENTHOOK showHook = NULL;
+static HWINEVENTHOOK moveSizeHook = NULL;
+static HWND pending[MAX_PENDING];
+static int pendingNext = 0;
+
+// Key for the executable the window belongs to plus its class. Returns zero
+// if we can't tell which executable that is.
+static ULONGLONG GetWindowGeometryKey(HWND hwnd)
+{
+	DWORD pid = 0;
+	GetWindowThreadProcessId(hwnd, &pid);
+	HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+	if (!process)
+		process = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pid);
+	if (!process)
+		return 0;
+	TCHAR path[MAX_PATH];
+	const DWORD length = GetProcessImageFileName(process, path, MAX_PATH);
+	CloseHandle(process);
+	if (!length)
+		return 0;
+
+	TCHAR className[256];
+	if (!GetClassName(hwnd, className, 256))
+		return 0;
+	return GetGeometryKey(path, className);
+}
+
+// Only ordinary application windows: top-level, unowned and with a caption.
+// Dialogs, menus, tooltips and the like are left to their owners.
+static bool IsRememberable(HWND hwnd)
+{
+	if (!hwnd || GetAncestor(hwnd, GA_ROOT) != hwnd || GetWindow(hwnd, GW_OWNER))
+		return false;
+	const LONG style = GetWindowLong(hwnd, GWL_STYLE);
+	const LONG exStyle = GetWindowLong(hwnd, GWL_EXSTYLE);
+	return (style & WS_CAPTION) == WS_CAPTION && !(style & WS_CHILD)
+		&& !(exStyle & WS_EX_TOOLWINDOW);
+}
+
+// The slot for key: its own, else the first free one along its probe
+// sequence, else the one along it that was written longest ago.
+static GeometryEntry *ClaimEntry(ULONGLONG key)
+{
+	GeometryEntry *stalest = NULL;
+	for (DWORD i = 0; i < MAX_PROBES; i++) {
+		GeometryEntry *entry = &table->entries[(key + i) & (GEOMETRY_CAPACITY - 1)];
+		if (entry->key == key || !entry->key)
+			return entry;
+		if (!stalest || (LONG)(entry->stamp - stalest->stamp) < 0)
+			stalest = entry;
+	}
+	return stalest;
+}
+
+void RememberGeometry(HWND hwnd)
+{
+	if (!table || !IsRememberable(hwnd) || IsIconic(hwnd))
+		return;
+	WINDOWPLACEMENT placement;
+	placement.length = sizeof(WINDOWPLACEMENT);
+	if (!GetWindowPlacement(hwnd, &placement))
+		return;
+	const ULONGLONG key = GetWindowGeometryKey(hwnd);
+	if (!key)
+		return;
+
+	// The hooks may be reading this entry from other processes; see
+	// ReadGeometryEntry().
+	GeometryEntry *entry = ClaimEntry(key);
+	InterlockedIncrement(&entry->seq);
+	entry->key = key;
+	entry->rect = placement.rcNormalPosition;
+	entry->isMaximized = (placement.showCmd == SW_SHOWMAXIMIZED);
+	entry->stamp = ++table->stamp;
+	InterlockedIncrement(&entry->seq);
+}
+
+static void RestoreGeometry(HWND hwnd)
+{
+	if (!IsRememberable(hwnd))
+		return;
+	const ULONGLONG key = GetWindowGeometryKey(hwnd);
+	if (!key)
+		return;
+	const GeometryEntry *entry = FindGeometryEntry(table, key);
+	if (!entry)
+		return;
+
+	WINDOWPLACEMENT placement;
+	placement.length = sizeof(WINDOWPLACEMENT);
+	if (!GetWindowPlacement(hwnd, &placement) || placement.showCmd != SW_SHOWNORMAL)
+		return;
+
+	// Don't put windows back on a monitor that isn't there any more.
+	if (!MonitorFromRect(&entry->rect, MONITOR_DEFAULTTONULL))
+		return;
+
+	// Windows that can't be resized keep their own size.
+	RECT rect = entry->rect;
+	if (!(GetWindowLong(hwnd, GWL_STYLE) & WS_THICKFRAME)) {
+		rect.right = rect.left + (placement.rcNormalPosition.right - placement.rcNormalPosition.left);
+		rect.bottom = rect.top + (placement.rcNormalPosition.bottom - placement.rcNormalPosition.top);
+	}
+	// Usually the CBT hook already put it there.
+	if (EqualRect(&rect, &placement.rcNormalPosition) && !entry->isMaximized)
+		return;
+	placement.rcNormalPosition = rect;
+	placement.flags = 0;
+	if (entry->isMaximized)
+		placement.showCmd = SW_SHOWMAXIMIZED;
+	SetWindowPlacement(hwnd, &placement);
+}
+
+// Returns true if hwnd was waiting to be shown for the first time, and
+// forgets it.
+static bool TakePending(HWND hwnd)
+{
+	for (int i = 0; i < MAX_PENDING; i++) {
+		if (pending[i] == hwnd) {
+			pending[i] = NULL;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void CALLBACK ShowEventProc(HWINEVENTHOOK hook, DWORD event, HWND hwnd,
+	LONG idObject, LONG idChild, DWORD thread, DWORD time)
+{
+	if (idObject != OBJID_WINDOW || idChild != CHILDID_SELF || !hwnd)
+		return;
+
+	switch (event) {
+	case EVENT_OBJECT_CREATE:
+		if (GetAncestor(hwnd, GA_ROOT) == hwnd) {
+			pending[pendingNext] = hwnd;
+			pendingNext = (pendingNext + 1) & (MAX_PENDING - 1);
+		}
+		break;
+	case EVENT_OBJECT_DESTROY:
+		TakePending(hwnd);
+		break;
+	case EVENT_OBJECT_SHOW:
+		if (TakePending(hwnd))
+			RestoreGeometry(hwnd);
+		break;
+	}
+}
+
+static void CALLBACK MoveSizeEventProc(HWINEVENTHOOK hook, DWORD event, HWND hwnd,
+	LONG idObject, LONG idChild, DWORD thread, DWORD time)
+{
+	if (idObject == OBJID_WINDOW && idChild == CHILDID_SELF)
+		RememberGeometry(hwnd);
+}
+
+static bool OpenGeometryTable(void)
+{
+	geometryFile = CreateFile(GEOMETRY_FILE, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+		OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (geometryFile == INVALID_HANDLE_VALUE) {
+		geometryFile = NULL;
+		return false;
+	}
+	geometryMapping = CreateFileMapping(geometryFile, NULL, PAGE_READWRITE,
+		0, sizeof(GeometryTable), GEOMETRY_MAPPING);
+	if (geometryMapping) {
+		table = (GeometryTable *)MapViewOfFile(geometryMapping,
+			FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(GeometryTable));
+	}
+	if (!table) {
+		StopGeometryMemory();
+		return false;
+	}
+
+	// New files come back zeroed. Start over on anything we don't recognize.
+	if (table->magic != GEOMETRY_MAGIC || table->version != GEOMETRY_VERSION
+		|| table->capacity != GEOMETRY_CAPACITY) {
+		ZeroMemory(table, sizeof(GeometryTable));
+		table->magic = GEOMETRY_MAGIC;
+		table->version = GEOMETRY_VERSION;
+		table->capacity = GEOMETRY_CAPACITY;
+	}
+	return true;
+}
+
+bool StartGeometryMemory(void)
+{
+	if (!table && !OpenGeometryTable())
+		return false;
+	if (!showHook) {
+		showHook = SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_SHOW, NULL,
+			ShowEventProc, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+	}
+	if (!moveSizeHook) {
+		moveSizeHook = SetWinEventHook(EVENT_SYSTEM_MOVESIZEEND, EVENT_SYSTEM_MOVESIZEEND, NULL,
+			MoveSizeEventProc, 0, 0, WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+	}
+	return showHook && moveSizeHook;
+}
+
+void StopGeometryMemory(void)
+{
+	if (showHook) {
+		UnhookWinEvent(showHook);
+		showHook = NULL;
+	}
+	if (moveSizeHook) {
+		UnhookWinEvent(moveSizeHook);
+		moveSizeHook = NULL;
+	}
+	ZeroMemory(pending, sizeof(pending));
+	if (table) {
+		FlushViewOfFile(table, 0);
+		UnmapViewOfFile(table);
+		table = NULL;
+	}
+	if (geometryMapping) {
+		CloseHandle(geometryMapping);
+		geometryMapping = NULL;
+	}
+	if (geometryFile) {
+		CloseHandle(geometryFile);
+		geometryFile = NULL;
+	}
+}
@@ -0,0 +1,23 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Geometry.h
+** Remembers where each application's windows were last put.
+*/
+
+#pragma once
+
+// Opens (or creates) the on-disk placement table and starts watching for new
+// windows. Returns false if the table can't be opened.
+bool StartGeometryMemory(void);
+
+// Stops watching and flushes the table to disk.
+void StopGeometryMemory(void);
+
+// Records the current placement of hwnd, if it's the kind of window we
+// remember. Called when a move or resize ends.
+void RememberGeometry(HWND hwnd);
@@ -23,6 +23,7 @@
 #include <Shlwapi.h>
 
 // C runtime header files.
+#include <stdio.h>
 #include <stdlib.h>
 #include <malloc.h>
 #include <memory.h>
@@ -30,22 +31,67 @@
 #include <string>
 
 #include "Grapple.h"
+#include "Control.h"
+#include "Geometry.h"
+#include "Preview.h"
+#include "Replay.h"
+#include "../GrappleLib/HookHealth.h"
 
 #define MY_MSG		(WM_APP+0)
 #define MY_ENABLE	(WM_APP+1)
 #define MY_DISABLE	(WM_APP+2)
 #define MY_ABOUT	(WM_APP+3)
 #define MY_QUIT		(WM_APP+4)
+#define MY_TRACE	(WM_APP+5)
+#define MY_SAVETRACE	(WM_APP+6)
+#define MY_PREDICT	(WM_APP+7)
+#define MY_GESTUREEND	(WM_APP+8)
+#define MY_REMEMBER	(WM_APP+9)
+#define MY_PREVIEW	(WM_APP+10)
+#define MY_REVEAL	(WM_APP+11)
+#define MY_REPLAYDONE	(WM_APP+12)
 
 typedef bool (WINAPI *InstallHookFn)(void);
 typedef void (WINAPI *RemoveHookFn)(void);
+typedef bool (WINAPI *EnableTraceFn)(bool);
+typedef bool (WINAPI *SaveTraceFn)(const TCHAR *);
+typedef void (WINAPI *SetPredictionFn)(bool, int);
+typedef void (WINAPI *GetHookHealthFn)(HookHealth *);
+typedef void (WINAPI *SetHookBudgetFn)(LONG, bool);
+typedef void (WINAPI *SetNotifyWindowFn)(HWND, UINT);
+typedef void (WINAPI *SetRevealPreviewFn)(HWND, UINT);
+typedef bool (WINAPI *ReinstallHookFn)(void);
+typedef bool (WINAPI *SetGeometryRestoreFn)(bool);
+typedef void (WINAPI *InvalidateTablesFn)(void);
 
 
 const TCHAR *APP_NAME = TEXT("Grapple");
-const TCHAR *APP_VERSION = TEXT("3.2");
+const TCHAR *APP_VERSION = TEXT("3.3");
 const TCHAR *DLL_FILE = TEXT("GrappleLib.dll");
+const TCHAR *TRACE_FILE = TEXT("GrappleTrace.json");
+const TCHAR *REPLAY_REPORT_FILE = TEXT("GrappleReplay.txt");
 const int MAX_LOADSTRING = 100;
 
+// Hook watchdog. Every tick we look at how slow the hooks have been and
+// whether they're still being called at all.
+static const UINT_PTR WATCHDOG_TIMER = 1;
+static const UINT WATCHDOG_INTERVAL_MS = 1000;
+static const int DEFAULT_BUDGET_MS = 10;
+
+// Start shedding when the slowest call gets this close to the budget
+// (in percent), and stop after this many ticks comfortably below it.
+static const LONG SHED_THRESHOLD = 75;
+static const int CALM_TICKS = 10;
+
+// Reinstall after this many ticks of the cursor moving with no hook calls,
+// but no more often than this.
+static const int SILENT_TICKS = 5;
+static const DWORD REINSTALL_INTERVAL_MS = 60000;
+
+// After a replay, give the hooked applications this long to work through
+// their input queues before reading the hook statistics.
+static const DWORD REPLAY_DRAIN_MS = 500;
+
 static HWND appWnd;
 static HINSTANCE hInst;
 
@@ -54,6 +100,29 @@ static HINSTANCE dllInst;
 static bool isHookInstalled = false;
 static InstallHookFn InstallHook;
 static RemoveHookFn RemoveHook;
+static bool isTracing = false;
+static EnableTraceFn EnableTrace;
+static SaveTraceFn SaveTrace;
+static bool isPredicting = false;
+static SetPredictionFn SetPrediction;
+static GetHookHealthFn GetHookHealth;
+static SetHookBudgetFn SetHookBudget;
+static SetNotifyWindowFn SetNotifyWindow;
+static bool isRemembering = true;
+static SetRevealPreviewFn SetRevealPreview;
+static ReinstallHookFn ReinstallHook;
+static SetGeometryRestoreFn SetGeometryRestore;
+static InvalidateTablesFn InvalidateTables;
+static bool isPreviewing = false;
+static int hookBudgetMs = DEFAULT_BUDGET_MS;
+static bool isShedding = false;
+static int calmTicks = 0;
+static int silentTicks = 0;
+static LONG lastHeartbeat = 0;
+static POINT lastCursor;
+static DWORD lastReinstall = 0;
+static bool hasReinstalled = false;
+static TCHAR replayFile[MAX_PATH] = TEXT("");
 
 
 // Pesky prototypes.
@@ -76,6 +145,24 @@ static void ShowAboutBox(const TCHAR *format, ...)
 	MessageBox(NULL, buf, TEXT("About"), MB_OK);
 }
 
+// The table has to be open before the hooks look anything up in it.
+static void StartRemembering(void)
+{
+	if (SetNotifyWindow)
+		SetNotifyWindow(appWnd, MY_GESTUREEND);
+	if (StartGeometryMemory() && SetGeometryRestore)
+		SetGeometryRestore(true);
+}
+
+static void StopRemembering(void)
+{
+	if (SetNotifyWindow)
+		SetNotifyWindow(NULL, 0);
+	if (SetGeometryRestore)
+		SetGeometryRestore(false);
+	StopGeometryMemory();
+}
+
 static void EnableGrapple(void)
 {
 	if (!dllInst) {
@@ -88,6 +175,18 @@ static void EnableGrapple(void)
 	if (!InstallHook || !RemoveHook) {
 		InstallHook = (InstallHookFn) GetProcAddress(dllInst, (LPCSTR) MAKEINTRESOURCE(1));
 		RemoveHook = (RemoveHookFn) GetProcAddress(dllInst, (LPCSTR) MAKEINTRESOURCE(2));
+		EnableTrace = (EnableTraceFn) GetProcAddress(dllInst, (LPCSTR) MAKEINTRESOURCE(3));
+		SaveTrace = (SaveTraceFn) GetProcAddress(dllInst, (LPCSTR) MAKEINTRESOURCE(4));
+		SetPrediction = (SetPredictionFn) GetProcAddress(dllInst, (LPCSTR) MAKEINTRESOURCE(5));
+		GetHookHealth = (GetHookHealthFn) GetProcAddress(dllInst, (LPCSTR) MAKEINTRESOURCE(6));
+		SetHookBudget = (SetHookBudgetFn) GetProcAddress(dllInst, (LPCSTR) MAKEINTRESOURCE(7));
+		SetNotifyWindow = (SetNotifyWindowFn) GetProcAddress(dllInst, (LPCSTR) MAKEINTRESOURCE(8));
+		SetRevealPreview = (SetRevealPreviewFn) GetProcAddress(dllInst, (LPCSTR) MAKEINTRESOURCE(9));
+		ReinstallHook = (ReinstallHookFn) GetProcAddress(dllInst, (LPCSTR) MAKEINTRESOURCE(10));
+		SetGeometryRestore = (SetGeometryRestoreFn) GetProcAddress(dllInst, (LPCSTR) MAKEINTRESOURCE(11));
+		InvalidateTables = (InvalidateTablesFn) GetProcAddress(dllInst, (LPCSTR) MAKEINTRESOURCE(12));
+		if (SetHookBudget)
+			SetHookBudget(hookBudgetMs * 1000, false);
 		if (!InstallHook || !RemoveHook) {
 			MessageBox(
 				NULL,
@@ -102,16 +201,327 @@ static void EnableGrapple(void)
 			isHookInstalled = true;
 		}
 	}
+	if (isHookInstalled && isRemembering) {
+		StartRemembering();
+	}
 }
 
 static void DisableGrapple(void)
 {
 	if (isHookInstalled) {
+		StopRemembering();
 		RemoveHook();
 		isHookInstalled = false;
 	}
 }
 
+// Toggle remembering where each application's windows were last put, and
+// putting new windows back there.
+static void ToggleRemember(void)
+{
+	isRemembering = !isRemembering;
+	if (!isHookInstalled)
+		return;
+	if (isRemembering) {
+		StartRemembering();
+	} else {
+		StopRemembering();
+	}
+}
+
+// Start or stop recording a timeline trace of hook activity.
+static void ToggleTrace(void)
+{
+	if (!EnableTrace)
+		return;
+	if (EnableTrace(!isTracing)) {
+		isTracing = !isTracing;
+	} else {
+		MessageBox(NULL, TEXT("Unable to start tracing."), TEXT("Error"), MB_OK);
+	}
+}
+
+// Write the trace recorded so far next to the application. The output is
+// Chrome trace-event JSON, so it can be loaded into chrome://tracing.
+static void WriteTraceFile(void)
+{
+	if (!SaveTrace || !SaveTrace(TRACE_FILE))
+		MessageBox(NULL, TEXT("Unable to save the trace file."), TEXT("Error"), MB_OK);
+}
+
+// Toggle leading the cursor while moving and resizing windows, to hide the
+// time it takes applications to repaint. Zero keeps the DLL's lead time.
+static void TogglePrediction(void)
+{
+	if (!SetPrediction)
+		return;
+	isPredicting = !isPredicting;
+	SetPrediction(isPredicting, 0);
+}
+
+// Pop up a balloon from the tray icon.
+static void ShowTrayNotice(const TCHAR *text)
+{
+	niData.uFlags = NIF_INFO;
+	_tcsncpy_s(niData.szInfoTitle, ARRAYSIZE(niData.szInfoTitle), APP_NAME, _TRUNCATE);
+	_tcsncpy_s(niData.szInfo, ARRAYSIZE(niData.szInfo), text, _TRUNCATE);
+	niData.dwInfoFlags = NIIF_WARNING;
+	Shell_NotifyIcon(NIM_MODIFY, &niData);
+}
+
+// Pause optional hook work (motion prediction, group dragging) while the
+// hooks are running close to their budget, and resume it once they've been
+// comfortably inside it for a while.
+static void CheckHookLatency(const HookHealth *health)
+{
+	const LONG budgetUs = hookBudgetMs * 1000;
+	if (health->maxLatencyUs > budgetUs * SHED_THRESHOLD / 100) {
+		calmTicks = 0;
+		if (!isShedding) {
+			isShedding = true;
+			SetHookBudget(budgetUs, true);
+			ShowTrayNotice(TEXT("Hooks are running close to their time budget. ")
+				TEXT("Motion prediction and group dragging are paused."));
+		}
+	} else if (isShedding && health->maxLatencyUs < budgetUs / 2 && ++calmTicks >= CALM_TICKS) {
+		isShedding = false;
+		SetHookBudget(budgetUs, false);
+		ShowTrayNotice(TEXT("Hooks are back within their time budget."));
+	}
+}
+
+#ifndef PROCESS_QUERY_LIMITED_INFORMATION
+#define PROCESS_QUERY_LIMITED_INFORMATION 0x1000
+#endif
+
+// TokenIntegrityLevel, which the XP headers don't have. What it returns is a
+// TOKEN_MANDATORY_LABEL, which is just a SID_AND_ATTRIBUTES.
+static const TOKEN_INFORMATION_CLASS TOKEN_INTEGRITY_LEVEL = (TOKEN_INFORMATION_CLASS)25;
+
+typedef BOOL (WINAPI *IsWow64ProcessFn)(HANDLE, PBOOL);
+
+static bool IsWow64(HANDLE process)
+{
+	static IsWow64ProcessFn isWow64Process = (IsWow64ProcessFn)
+		GetProcAddress(GetModuleHandle(TEXT("kernel32")), "IsWow64Process");
+	BOOL isWow64 = FALSE;
+	return isWow64Process && isWow64Process(process, &isWow64) && isWow64;
+}
+
+// The integrity level RID of a process (SECURITY_MANDATORY_*_RID), or zero
+// where there's no such thing, as on XP.
+static DWORD GetIntegrityLevel(HANDLE process)
+{
+	HANDLE token;
+	if (!OpenProcessToken(process, TOKEN_QUERY, &token))
+		return 0;
+	ULONG_PTR buf[16];   // Room for the label and its SID, suitably aligned.
+	DWORD size;
+	DWORD level = 0;
+	if (GetTokenInformation(token, TOKEN_INTEGRITY_LEVEL, buf, sizeof(buf), &size)) {
+		const PSID sid = ((SID_AND_ATTRIBUTES *)buf)->Sid;
+		level = *GetSidSubAuthority(sid, *GetSidSubAuthorityCount(sid) - 1);
+	}
+	CloseHandle(token);
+	return level;
+}
+
+// Whether input to the window under pt should reach our hooks. It doesn't for
+// processes of the other bitness, or at a higher integrity level than ours
+// (elevated ones, from an unelevated Grapple). When we can't even look, we
+// assume it doesn't.
+static bool IsHookableAt(const POINT pt)
+{
+	const HWND hwnd = WindowFromPoint(pt);
+	DWORD pid = 0;
+	if (!hwnd || !GetWindowThreadProcessId(hwnd, &pid) || pid == GetCurrentProcessId())
+		return true;
+
+	HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+	if (!process)
+		process = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pid);
+	if (!process)
+		return false;
+	bool isHookable = IsWow64(process) == IsWow64(GetCurrentProcess());
+	if (isHookable) {
+		// Where we can read our own level, not being able to read theirs
+		// means they're out of our reach.
+		const DWORD ours = GetIntegrityLevel(GetCurrentProcess());
+		const DWORD theirs = GetIntegrityLevel(process);
+		isHookable = !ours || (theirs && theirs <= ours);
+	}
+	CloseHandle(process);
+	return isHookable;
+}
+
+// If the mouse has been moving over windows our hooks should be seeing but
+// the heartbeat hasn't moved, the hooks are gone, so put them back. Input to
+// elevated windows and to processes of the other bitness never reaches our
+// hooks, and that's normal, so ticks spent over those don't count. Even so,
+// we wait a few ticks and limit how often we do this.
+static void CheckHookHeartbeat(const HookHealth *health)
+{
+	POINT cursor;
+	GetCursorPos(&cursor);
+	const bool hasMoved = cursor.x != lastCursor.x || cursor.y != lastCursor.y;
+	lastCursor = cursor;
+
+	if (health->heartbeat != lastHeartbeat) {
+		lastHeartbeat = health->heartbeat;
+		silentTicks = 0;
+		return;
+	}
+	if (!hasMoved)
+		return;
+	if (!IsHookableAt(cursor)) {
+		silentTicks = 0;
+		return;
+	}
+	if (++silentTicks < SILENT_TICKS)
+		return;
+	silentTicks = 0;
+
+	const DWORD now = GetTickCount();
+	if (hasReinstalled && now - lastReinstall < REINSTALL_INTERVAL_MS)
+		return;
+	hasReinstalled = true;
+	lastReinstall = now;
+
+	// Not InstallHook(), which complains with a message box. Its modal loop
+	// would keep running our timer and stack up more boxes.
+	isHookInstalled = ReinstallHook();
+	ShowTrayNotice(isHookInstalled
+		? TEXT("Hooks stopped responding and were reinstalled.")
+		: TEXT("Hooks stopped responding and could not be reinstalled."));
+}
+
+static void CheckHookHealth(void)
+{
+	if (!isHookInstalled || !GetHookHealth || !SetHookBudget || !ReinstallHook)
+		return;
+
+	HookHealth health;
+	GetHookHealth(&health);
+	CheckHookLatency(&health);
+	CheckHookHeartbeat(&health);
+}
+
+// Pick up a "/budget:<ms>" hook latency budget and a "/replay:<file>"
+// recording from the command line. The file name may be quoted.
+static void ParseCommandLine(const TCHAR *cmdLine)
+{
+	const TCHAR *budget = _tcsstr(cmdLine, TEXT("/budget:"));
+	if (budget) {
+		const int ms = _ttoi(budget + 8);
+		if (ms > 0)
+			hookBudgetMs = ms;
+	}
+
+	const TCHAR *replay = _tcsstr(cmdLine, TEXT("/replay:"));
+	if (replay) {
+		replay += 8;
+		const bool isQuoted = (*replay == TEXT('"'));
+		if (isQuoted)
+			replay++;
+		size_t len = 0;
+		while (replay[len] && len < MAX_PATH - 1) {
+			if (isQuoted ? (replay[len] == TEXT('"')) : _istspace(replay[len]))
+				break;
+			len++;
+		}
+		_tcsncpy_s(replayFile, MAX_PATH, replay, len);
+	}
+}
+
+// Plays back the recording named on the command line with the hooks
+// installed, and writes out how fast the input went through and how much
+// time our hooks added to it. Used for benchmarking on machines with nobody
+// at them, so it reports to a file rather than the screen.
+static void RunReplay(void)
+{
+	FILE *f;
+	if (_tfopen_s(&f, REPLAY_REPORT_FILE, TEXT("wt")) != 0)
+		return;
+
+	// Reading the statistics starts a fresh measurement window.
+	HookHealth before, after;
+	ZeroMemory(&before, sizeof(HookHealth));
+	ZeroMemory(&after, sizeof(HookHealth));
+	if (GetHookHealth)
+		GetHookHealth(&before);
+
+	ReplayStats stats;
+	if (!isHookInstalled || !ReplayEvdevFile(replayFile, &stats)) {
+		fprintf(f, "error: %s\n", isHookInstalled ?
+			"could not open the recording" : "hooks are not installed");
+		fclose(f);
+		return;
+	}
+	Sleep(REPLAY_DRAIN_MS);
+	if (GetHookHealth)
+		GetHookHealth(&after);
+
+	const LONG calls = after.heartbeat - before.heartbeat;
+	fprintf(f, "events: %lu\n", stats.events);
+	fprintf(f, "frames: %lu\n", stats.frames);
+	fprintf(f, "inputs: %lu\n", stats.inputs);
+	fprintf(f, "dropped: %lu\n", stats.dropped);
+	fprintf(f, "skipped: %lu\n", stats.skipped);
+	fprintf(f, "elapsed_ms: %.3f\n", stats.elapsedMs);
+	fprintf(f, "events_per_sec: %.0f\n",
+		stats.elapsedMs > 0 ? stats.events * 1000.0 / stats.elapsedMs : 0.0);
+	fprintf(f, "max_sendinput_us: %.1f\n", stats.maxFrameUs);
+	fprintf(f, "hook_calls: %ld\n", calls);
+	fprintf(f, "hook_mean_us: %.1f\n",
+		calls > 0 ? (double)after.totalLatencyUs / calls : 0.0);
+	fprintf(f, "hook_max_us: %ld\n", after.maxLatencyUs);
+	fprintf(f, "hook_slow_calls: %ld\n", after.slowCalls);
+	fclose(f);
+}
+
+// The replay runs on its own thread. The hooks are called from our thread
+// too, whenever the input being played back passes through one of our own
+// windows, so this thread has to keep pumping messages all along.
+static DWORD WINAPI ReplayThreadProc(LPVOID param)
+{
+	RunReplay();
+	PostMessage(appWnd, MY_REPLAYDONE, 0, 0);
+	return 0;
+}
+
+static bool StartReplay(void)
+{
+	HANDLE thread = CreateThread(NULL, 0, ReplayThreadProc, NULL, 0, NULL);
+	if (!thread)
+		return false;
+	CloseHandle(thread);
+	return true;
+}
+
+// Toggle outlining what ALT+middle-click is about to reveal while the button
+// is held down.
+static void TogglePreview(void)
+{
+	if (!SetRevealPreview)
+		return;
+	isPreviewing = !isPreviewing;
+	SetRevealPreview(isPreviewing ? appWnd : NULL, MY_REVEAL);
+	if (!isPreviewing)
+		ClosePreview();
+}
+
+// The hooks pack the outline into the message parameters like mouse
+// coordinates. An empty rectangle takes the outline down.
+static void HandleReveal(WPARAM wParam, LPARAM lParam)
+{
+	RECT r;
+	r.left = GET_X_LPARAM(wParam);
+	r.top = GET_Y_LPARAM(wParam);
+	r.right = GET_X_LPARAM(lParam);
+	r.bottom = GET_Y_LPARAM(lParam);
+	ShowPreview(hInst, &r);
+}
+
 // Set the current working directory to the same one the application is in.
 static void ChangeToAppPath(void)
 {
@@ -126,12 +536,25 @@ int	APIENTRY _tWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
 					   LPTSTR lpCmdLine, int nCmdShow)
 {
 	ChangeToAppPath();
+	ParseCommandLine(lpCmdLine);
 	MyRegisterClass(hInstance);
 	if (!InitInstance(hInstance, nCmdShow))
 		return 0;
 
 	EnableGrapple();
 
+	// Not fatal: scripting is an extra, and a second copy of Grapple
+	// will find the pipe already taken.
+	StartControlServer(InvalidateTables);
+
+	// A replay run is a benchmark: play the recording, report, and quit.
+	// The watchdog stays off, since reading the hook statistics would reset
+	// the ones the report is made from, and shedding would skew them.
+	if (!replayFile[0])
+		SetTimer(appWnd, WATCHDOG_TIMER, WATCHDOG_INTERVAL_MS, NULL);
+	else if (!StartReplay())
+		DestroyWindow(appWnd);
+
 	// Main	message	loop.
 	MSG msg;
 	while (GetMessage(&msg,	NULL, 0, 0)) {
@@ -209,6 +632,7 @@ static bool InitInstance(HINSTANCE hInstance, int nCmdShow)
 	HWND hWnd = CreateWindow(APP_NAME, APP_NAME, WS_OVERLAPPED | WS_THICKFRAME,
 		CW_USEDEFAULT, 0, CW_USEDEFAULT, 0, NULL, NULL, hInstance, NULL);
 	if (hWnd) {
+		appWnd = hWnd;
 		InstallTrayIcon(hWnd, hInstance);
 
 		// We don't have much of an interface yet...
@@ -250,10 +674,20 @@ static void ShowContextMenu(HWND hWnd)
 		InsertMenuItem(hMenu, 1, TRUE, &item);
 		SetCheckedMenuItem(&item, MY_DISABLE, TEXT("Disable"), !isHookInstalled);
 		InsertMenuItem(hMenu, 2, TRUE, &item);
-		SetNormalMenuItem(&item, MY_ABOUT, TEXT("About"));
+		SetCheckedMenuItem(&item, MY_PREDICT, TEXT("Predict Motion"), isPredicting);
 		InsertMenuItem(hMenu, 3, TRUE, &item);
-		SetNormalMenuItem(&item, MY_QUIT, TEXT("Quit"));
+		SetCheckedMenuItem(&item, MY_REMEMBER, TEXT("Remember Placement"), isRemembering);
 		InsertMenuItem(hMenu, 4, TRUE, &item);
+		SetCheckedMenuItem(&item, MY_PREVIEW, TEXT("Preview Send to Back"), isPreviewing);
+		InsertMenuItem(hMenu, 5, TRUE, &item);
+		SetCheckedMenuItem(&item, MY_TRACE, TEXT("Record Trace"), isTracing);
+		InsertMenuItem(hMenu, 6, TRUE, &item);
+		SetNormalMenuItem(&item, MY_SAVETRACE, TEXT("Save Trace"));
+		InsertMenuItem(hMenu, 7, TRUE, &item);
+		SetNormalMenuItem(&item, MY_ABOUT, TEXT("About"));
+		InsertMenuItem(hMenu, 8, TRUE, &item);
+		SetNormalMenuItem(&item, MY_QUIT, TEXT("Quit"));
+		InsertMenuItem(hMenu, 9, TRUE, &item);
 
 		// We must set our window to the foreground or the menu won't
 		// disappear when it should.
@@ -295,6 +729,21 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM l
 		case MY_DISABLE:
 			DisableGrapple();
 			break;
+		case MY_PREDICT:
+			TogglePrediction();
+			break;
+		case MY_REMEMBER:
+			ToggleRemember();
+			break;
+		case MY_PREVIEW:
+			TogglePreview();
+			break;
+		case MY_TRACE:
+			ToggleTrace();
+			break;
+		case MY_SAVETRACE:
+			WriteTraceFile();
+			break;
 		case MY_ABOUT:
 			ShowAboutBox(
 				TEXT("%s v%s\nCopyright (C) 2005-2010 Will Hui"),
@@ -308,7 +757,28 @@ static LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM l
 		}
 		break;
 
+	case MY_REVEAL:
+		HandleReveal(wParam, lParam);
+		break;
+
+	case MY_GESTUREEND:
+		RememberGeometry((HWND)wParam);
+		break;
+
+	case MY_REPLAYDONE:
+		DestroyWindow(hWnd);
+		break;
+
+	case WM_TIMER:
+		if (wParam == WATCHDOG_TIMER)
+			CheckHookHealth();
+		break;
+
 	case WM_DESTROY:
+		KillTimer(hWnd, WATCHDOG_TIMER);
+		if (SetRevealPreview)
+			SetRevealPreview(NULL, 0);
+		ClosePreview();
 		DisableGrapple();
 		niData.uFlags = 0;
 		Shell_NotifyIcon(NIM_DELETE, &niData);
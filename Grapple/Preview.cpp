@@ -0,0 +1,75 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Preview.cpp
+** Outline of what a send-to-back is about to reveal.
+**
+** The outline is a topmost, click-through layered window whose region is
+** just a frame, so there's nothing to paint beyond the class background.
+*/
+
+#include "stdafx.h"
+#include "Preview.h"
+
+static const TCHAR *PREVIEW_CLASS = TEXT("GrapplePreview");
+static const int PREVIEW_THICKNESS = 4;
+static const BYTE PREVIEW_ALPHA = 192;
+
+static HWND previewWnd = NULL;
+
+static HWND CreatePreviewWindow(HINSTANCE hInstance)
+{
+	WNDCLASSEX wcex;
+	ZeroMemory(&wcex, sizeof(WNDCLASSEX));
+	wcex.cbSize = sizeof(WNDCLASSEX);
+	wcex.lpfnWndProc = DefWindowProc;
+	wcex.hInstance = hInstance;
+	wcex.hbrBackground = GetSysColorBrush(COLOR_HIGHLIGHT);
+	wcex.lpszClassName = PREVIEW_CLASS;
+	RegisterClassEx(&wcex);
+
+	HWND hwnd = CreateWindowEx(
+		WS_EX_LAYERED | WS_EX_TRANSPARENT | WS_EX_TOPMOST | WS_EX_TOOLWINDOW | WS_EX_NOACTIVATE,
+		PREVIEW_CLASS, NULL, WS_POPUP, 0, 0, 0, 0, NULL, NULL, hInstance, NULL);
+	if (hwnd)
+		SetLayeredWindowAttributes(hwnd, 0, PREVIEW_ALPHA, LWA_ALPHA);
+	return hwnd;
+}
+
+void ShowPreview(HINSTANCE hInstance, const RECT *r)
+{
+	if (IsRectEmpty(r)) {
+		if (previewWnd)
+			ShowWindow(previewWnd, SW_HIDE);
+		return;
+	}
+	if (!previewWnd)
+		previewWnd = CreatePreviewWindow(hInstance);
+	if (!previewWnd)
+		return;
+
+	const int w = r->right - r->left;
+	const int h = r->bottom - r->top;
+	HRGN frame = CreateRectRgn(0, 0, w, h);
+	HRGN inside = CreateRectRgn(PREVIEW_THICKNESS, PREVIEW_THICKNESS,
+		w - PREVIEW_THICKNESS, h - PREVIEW_THICKNESS);
+	CombineRgn(frame, frame, inside, RGN_DIFF);
+	DeleteObject(inside);
+
+	// The window owns the region from here on.
+	SetWindowRgn(previewWnd, frame, FALSE);
+	SetWindowPos(previewWnd, HWND_TOPMOST, r->left, r->top, w, h,
+		SWP_NOACTIVATE | SWP_SHOWWINDOW);
+}
+
+void ClosePreview(void)
+{
+	if (previewWnd) {
+		DestroyWindow(previewWnd);
+		previewWnd = NULL;
+	}
+}
@@ -0,0 +1,19 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Preview.h
+** Outline of what a send-to-back is about to reveal.
+*/
+
+#pragma once
+
+// Outlines r (in screen coordinates) above everything else, or hides the
+// outline if r is empty. The outline never takes focus or mouse input.
+void ShowPreview(HINSTANCE hInstance, const RECT *r);
+
+// Destroys the outline window, if there is one.
+void ClosePreview(void);
@@ -0,0 +1,225 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Replay.cpp
+** Plays back recorded pointer and key events through the system input queue.
+**
+** Recordings use the Linux evdev record format, since that's what every
+** input recorder out there can already produce and it's trivial to generate
+** from a script. Events are gathered up to each SYN_REPORT, the same way the
+** kernel delivers them, and each frame goes to SendInput() in one call. That
+** way the input takes the same path through the system, our hooks and the
+** target windows that a real device's input would.
+*/
+
+#include "stdafx.h"
+#include "Replay.h"
+#include "Evdev.h"
+#include <cstdio>
+
+// BTN_RIGHT is 0x111, so the three buttons are contiguous.
+static const WORD BTN_LEFT = 0x110;
+static const WORD BTN_MIDDLE = 0x112;
+
+struct KeyMapping {
+	WORD code;
+	WORD vk;
+};
+
+static const KeyMapping KEY_MAP[] = {
+	{ 1, VK_ESCAPE },     // KEY_ESC
+	{ 29, VK_CONTROL },   // KEY_LEFTCTRL
+	{ 42, VK_SHIFT },     // KEY_LEFTSHIFT
+	{ 44, 'Z' },          // KEY_Z
+	{ 54, VK_SHIFT },     // KEY_RIGHTSHIFT
+	{ 56, VK_MENU },      // KEY_LEFTALT
+	{ 97, VK_CONTROL },   // KEY_RIGHTCTRL
+	{ 100, VK_MENU },     // KEY_RIGHTALT
+};
+static const int KEY_COUNT = sizeof(KEY_MAP) / sizeof(KEY_MAP[0]);
+
+static const int BUTTON_COUNT = 3;
+static const DWORD BUTTON_DOWN[BUTTON_COUNT] = {
+	MOUSEEVENTF_LEFTDOWN, MOUSEEVENTF_RIGHTDOWN, MOUSEEVENTF_MIDDLEDOWN
+};
+static const DWORD BUTTON_UP[BUTTON_COUNT] = {
+	MOUSEEVENTF_LEFTUP, MOUSEEVENTF_RIGHTUP, MOUSEEVENTF_MIDDLEUP
+};
+
+// Records are read in blocks of this many.
+static const int READ_BLOCK = 256;
+
+// A frame with more inputs than this is sent in pieces.
+static const int MAX_FRAME_INPUTS = 32;
+
+struct ReplayState {
+	INPUT frame[MAX_FRAME_INPUTS];
+	int count;
+	LONG dx, dy, wheel;
+	bool isKeyDown[KEY_COUNT];
+	bool isButtonDown[BUTTON_COUNT];
+	double usPerTick;
+	ReplayStats *stats;
+};
+
+static void SendFrame(ReplayState *state)
+{
+	if (!state->count)
+		return;
+
+	LARGE_INTEGER begin, end;
+	QueryPerformanceCounter(&begin);
+	const UINT sent = SendInput(state->count, state->frame, sizeof(INPUT));
+	QueryPerformanceCounter(&end);
+
+	const double us = (end.QuadPart - begin.QuadPart) * state->usPerTick;
+	if (us > state->stats->maxFrameUs)
+		state->stats->maxFrameUs = us;
+	state->stats->inputs += state->count;
+	state->stats->dropped += state->count - sent;
+	state->count = 0;
+}
+
+static INPUT *AddInput(ReplayState *state, DWORD type)
+{
+	if (state->count == MAX_FRAME_INPUTS)
+		SendFrame(state);
+	INPUT *input = &state->frame[state->count++];
+	ZeroMemory(input, sizeof(INPUT));
+	input->type = type;
+	return input;
+}
+
+static void AddMouse(ReplayState *state, DWORD flags, LONG dx, LONG dy, DWORD data)
+{
+	INPUT *input = AddInput(state, INPUT_MOUSE);
+	input->mi.dx = dx;
+	input->mi.dy = dy;
+	input->mi.mouseData = data;
+	input->mi.dwFlags = flags;
+}
+
+static void AddKey(ReplayState *state, WORD vk, bool isDown)
+{
+	INPUT *input = AddInput(state, INPUT_KEYBOARD);
+	input->ki.wVk = vk;
+	input->ki.dwFlags = isDown ? 0 : KEYEVENTF_KEYUP;
+}
+
+// Motion and wheel are accumulated over the frame and go out ahead of any
+// button or key changes, like a real device that reports them together.
+static void AddMotion(ReplayState *state)
+{
+	if (state->dx || state->dy)
+		AddMouse(state, MOUSEEVENTF_MOVE, state->dx, state->dy, 0);
+	if (state->wheel)
+		AddMouse(state, MOUSEEVENTF_WHEEL, 0, 0, (DWORD)(state->wheel * WHEEL_DELTA));
+	state->dx = state->dy = state->wheel = 0;
+}
+
+static bool PlayKey(ReplayState *state, const EvdevEvent *e)
+{
+	// A value of 2 is autorepeat, which Windows sees as another key down.
+	const bool isDown = (e->value != 0);
+
+	if (e->code >= BTN_LEFT && e->code <= BTN_MIDDLE) {
+		const int button = e->code - BTN_LEFT;
+		if (isDown == state->isButtonDown[button])
+			return true;
+		AddMotion(state);
+		AddMouse(state, isDown ? BUTTON_DOWN[button] : BUTTON_UP[button], 0, 0, 0);
+		state->isButtonDown[button] = isDown;
+		return true;
+	}
+
+	for (int i = 0; i < KEY_COUNT; i++) {
+		if (KEY_MAP[i].code == e->code) {
+			AddMotion(state);
+			AddKey(state, KEY_MAP[i].vk, isDown);
+			state->isKeyDown[i] = isDown;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool PlayEvent(ReplayState *state, const EvdevEvent *e)
+{
+	switch (e->type) {
+	case EV_SYN:
+		if (e->code != SYN_REPORT)
+			return false;
+		AddMotion(state);
+		SendFrame(state);
+		state->stats->frames++;
+		return true;
+
+	case EV_REL:
+		if (e->code == REL_X)
+			state->dx += e->value;
+		else if (e->code == REL_Y)
+			state->dy += e->value;
+		else if (e->code == REL_WHEEL)
+			state->wheel += e->value;
+		else
+			return false;
+		return true;
+
+	case EV_KEY:
+		return PlayKey(state, e);
+	}
+	return false;
+}
+
+// Lets go of anything the recording left held down, so a truncated
+// recording can't leave ALT stuck.
+static void ReleaseAll(ReplayState *state)
+{
+	AddMotion(state);
+	for (int i = 0; i < BUTTON_COUNT; i++) {
+		if (state->isButtonDown[i])
+			AddMouse(state, BUTTON_UP[i], 0, 0, 0);
+	}
+	for (int i = 0; i < KEY_COUNT; i++) {
+		if (state->isKeyDown[i])
+			AddKey(state, KEY_MAP[i].vk, false);
+	}
+	SendFrame(state);
+}
+
+bool ReplayEvdevFile(const TCHAR *path, ReplayStats *stats)
+{
+	ZeroMemory(stats, sizeof(ReplayStats));
+
+	FILE *f;
+	if (_tfopen_s(&f, path, TEXT("rb")) != 0)
+		return false;
+
+	ReplayState state;
+	ZeroMemory(&state, sizeof(ReplayState));
+	state.stats = stats;
+	LARGE_INTEGER frequency, begin, end;
+	QueryPerformanceFrequency(&frequency);
+	state.usPerTick = 1000000.0 / (double)frequency.QuadPart;
+
+	EvdevEvent block[READ_BLOCK];
+	QueryPerformanceCounter(&begin);
+	size_t n;
+	while ((n = fread(block, sizeof(EvdevEvent), READ_BLOCK, f)) > 0) {
+		for (size_t i = 0; i < n; i++) {
+			if (!PlayEvent(&state, &block[i]))
+				stats->skipped++;
+		}
+		stats->events += (DWORD)n;
+	}
+	ReleaseAll(&state);
+	QueryPerformanceCounter(&end);
+	fclose(f);
+
+	stats->elapsedMs = (end.QuadPart - begin.QuadPart) * state.usPerTick / 1000.0;
+	return true;
+}
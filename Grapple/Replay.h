@@ -0,0 +1,30 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Replay.h
+** Plays back recorded pointer and key events through the system input queue.
+*/
+
+#pragma once
+
+struct ReplayStats {
+	DWORD events;        // Records read from the recording.
+	DWORD frames;        // Complete frames (up to each SYN_REPORT) played back.
+	DWORD inputs;        // Inputs handed to SendInput().
+	DWORD dropped;       // Inputs SendInput() refused.
+	DWORD skipped;       // Records we don't know how to play back.
+	double elapsedMs;    // Time spent playing back, not counting the drain.
+	double maxFrameUs;   // Slowest single SendInput() call.
+};
+
+// Plays back a recording of Linux evdev events (the struct input_event
+// records you get by reading /dev/input/event* on a 64-bit kernel) as fast
+// as SendInput() will take them, ignoring the recorded timestamps. Relative
+// motion, the three mouse buttons, the wheel, and the ALT, SHIFT, CTRL, Z and
+// ESC keys are played back; everything else is counted in stats->skipped.
+// Anything still held down at the end of the recording is released.
+bool ReplayEvdevFile(const TCHAR *path, ReplayStats *stats);
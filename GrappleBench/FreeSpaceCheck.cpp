@@ -0,0 +1,154 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** FreeSpaceCheck.cpp
+** Checks and times the free space solver.
+**
+** FindFreeSpace() is checked against FindFreeSpaceExhaustive() on generated
+** layouts: small areas with a handful of obstacles, which can poke out of
+** the area, overlap each other, share edges or cover the point. Then it's
+** timed on full-screen layouts with hundreds of windows.
+*/
+
+#include "stdafx.h"
+#include "GrappleBench.h"
+#include "../GrappleLib/FreeSpace.h"
+#include <vector>
+
+static const int DEFAULT_LAYOUTS = 10000;
+static const int MAX_OBSTACLES = 10;
+static const int TIMING_RUNS = 20;
+
+// Same sequence on every run, so a failure can be reproduced.
+static DWORD seed = 7;
+
+static LONG Random(LONG range)
+{
+	seed = seed * 1103515245 + 12345;
+	return (LONG)((seed >> 8) % (DWORD)range);
+}
+
+static LONGLONG Area(const RECT &r)
+{
+	return (LONGLONG)(r.right - r.left) * (LONGLONG)(r.bottom - r.top);
+}
+
+static bool Contains(const RECT &r, const POINT pt)
+{
+	return pt.x >= r.left && pt.x < r.right && pt.y >= r.top && pt.y < r.bottom;
+}
+
+// Whether result is a rectangle FindFreeSpace() was allowed to return.
+static bool IsFree(const std::vector<RECT> &obstacles, const RECT &area,
+	const POINT pt, const RECT &result)
+{
+	if (!Contains(result, pt) || result.left < area.left || result.top < area.top ||
+			result.right > area.right || result.bottom > area.bottom)
+		return false;
+	for (size_t i = 0; i < obstacles.size(); i++) {
+		const RECT &r = obstacles[i];
+		if (Contains(r, pt))
+			continue;
+		if (r.left < result.right && r.right > result.left &&
+				r.top < result.bottom && r.bottom > result.top)
+			return false;
+	}
+	return true;
+}
+
+static void PrintRect(const char *name, const RECT &r)
+{
+	printf("  %s: (%ld, %ld) - (%ld, %ld)\n", name, r.left, r.top, r.right, r.bottom);
+}
+
+static bool CheckLayout(int layout)
+{
+	RECT area;
+	area.left = Random(50);
+	area.top = Random(50);
+	area.right = area.left + 1 + Random(40);
+	area.bottom = area.top + 1 + Random(40);
+
+	POINT pt;
+	pt.x = area.left + Random(area.right - area.left);
+	pt.y = area.top + Random(area.bottom - area.top);
+
+	std::vector<RECT> obstacles(Random(MAX_OBSTACLES + 1));
+	for (size_t i = 0; i < obstacles.size(); i++) {
+		RECT &r = obstacles[i];
+		r.left = area.left - 5 + Random(area.right - area.left + 10);
+		r.top = area.top - 5 + Random(area.bottom - area.top + 10);
+		r.right = r.left + 1 + Random(20);
+		r.bottom = r.top + 1 + Random(20);
+	}
+
+	RECT expected, result;
+	FindFreeSpaceExhaustive(obstacles.empty() ? NULL : &obstacles[0],
+		(int)obstacles.size(), &area, pt, &expected);
+	std::vector<RECT> scratch = obstacles;
+	FindFreeSpace(scratch.empty() ? NULL : &scratch[0], (int)scratch.size(), &area, pt, &result);
+
+	if (Area(result) == Area(expected) && IsFree(obstacles, area, pt, result))
+		return true;
+
+	printf("layout %d: mismatch at point (%ld, %ld)\n", layout, pt.x, pt.y);
+	PrintRect("area", area);
+	for (size_t i = 0; i < obstacles.size(); i++)
+		PrintRect("obstacle", obstacles[i]);
+	PrintRect("expected", expected);
+	PrintRect("got", result);
+	return false;
+}
+
+static void TimeLayout(int count)
+{
+	RECT area = { 0, 0, 1920, 1080 };
+	POINT pt = { 960, 540 };
+	std::vector<RECT> obstacles(count);
+	for (int i = 0; i < count; i++) {
+		RECT &r = obstacles[i];
+		r.left = Random(1900);
+		r.top = Random(1060);
+		r.right = r.left + 50 + Random(400);
+		r.bottom = r.top + 50 + Random(300);
+	}
+
+	LARGE_INTEGER frequency, begin, end;
+	QueryPerformanceFrequency(&frequency);
+	LONGLONG ticks = 0;
+	for (int run = 0; run < TIMING_RUNS; run++) {
+		std::vector<RECT> scratch = obstacles;
+		RECT result;
+		QueryPerformanceCounter(&begin);
+		FindFreeSpace(&scratch[0], count, &area, pt, &result);
+		QueryPerformanceCounter(&end);
+		ticks += end.QuadPart - begin.QuadPart;
+	}
+	printf("obstacles: %d  us_per_call: %.1f\n", count,
+		ticks * 1e6 / (double)frequency.QuadPart / TIMING_RUNS);
+}
+
+int RunFreeSpaceCheck(int argc, TCHAR *argv[])
+{
+	int layouts = DEFAULT_LAYOUTS;
+	for (int i = 0; i < argc; i++) {
+		if (_tcsnicmp(argv[i], TEXT("/layouts:"), 9) == 0)
+			layouts = _ttoi(argv[i] + 9);
+	}
+
+	int failures = 0;
+	for (int i = 0; i < layouts; i++) {
+		if (!CheckLayout(i))
+			failures++;
+	}
+	printf("layouts: %d  mismatches: %d\n", layouts, failures);
+
+	TimeLayout(100);
+	TimeLayout(500);
+	TimeLayout(1000);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** GrappleBench.cpp
+** Offline benchmarks and checks for GrappleLib's algorithms.
+**
+** The benchmarks build GrappleLib's sources straight into this console
+** program, so they measure the same code the hooks run without installing
+** any hooks or needing anybody at the desktop. Usage:
+**
+**   GrappleBench <benchmark> [arguments]
+*/
+
+#include "stdafx.h"
+#include "GrappleBench.h"
+
+typedef int (*BenchFn)(int argc, TCHAR *argv[]);
+
+struct Bench {
+	const TCHAR *name;
+	const TCHAR *usage;
+	BenchFn run;
+};
+
+static const Bench BENCHES[] = {
+	{ TEXT("freespace"), TEXT("[/layouts:<count>]"), RunFreeSpaceCheck },
+	{ TEXT("plugins"), TEXT("[<SlowPlugin.dll>]"), RunPluginCheck },
+	{ TEXT("predict"), TEXT("[<evdev recording>] [/lead:<ms>]"), RunPredictBench },
+	{ TEXT("table"), TEXT(""), RunTableBench },
+};
+static const int BENCH_COUNT = sizeof(BENCHES) / sizeof(BENCHES[0]);
+
+static int ShowUsage(void)
+{
+	_tprintf(TEXT("usage: GrappleBench <benchmark> [arguments]\n"));
+	for (int i = 0; i < BENCH_COUNT; i++)
+		_tprintf(TEXT("  %s %s\n"), BENCHES[i].name, BENCHES[i].usage);
+	return 2;
+}
+
+int _tmain(int argc, TCHAR *argv[])
+{
+	if (argc < 2)
+		return ShowUsage();
+
+	for (int i = 0; i < BENCH_COUNT; i++) {
+		if (_tcsicmp(argv[1], BENCHES[i].name) == 0)
+			return BENCHES[i].run(argc - 2, argv + 2);
+	}
+	return ShowUsage();
+}
@@ -0,0 +1,31 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** GrappleBench.h
+** Offline benchmarks and checks for GrappleLib's algorithms.
+*/
+
+#pragma once
+
+// Each benchmark takes the arguments that follow its name on the command
+// line, prints its results to stdout and returns the process exit code.
+
+// Replays pointer motion through the motion predictor.
+int RunPredictBench(int argc, TCHAR *argv[]);
+
+// Times window table hit tests on made-up and real desktops. Fails if the
+// vector and scalar hit tests ever disagree.
+int RunTableBench(int argc, TCHAR *argv[]);
+
+// Sends gestures to SamplePlugins' SlowPlugin.dll (or the plugin named on
+// the command line). Fails unless it's skipped after each overrun and
+// dropped after the third.
+int RunPluginCheck(int argc, TCHAR *argv[]);
+
+// Checks the free space solver against brute force on generated layouts,
+// then times it on big ones. Fails if any layout comes out wrong.
+int RunFreeSpaceCheck(int argc, TCHAR *argv[]);
@@ -0,0 +1,76 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** PluginCheck.cpp
+** Checks that slow plugins are skipped, and then dropped.
+**
+** Loads SlowPlugin.dll from SamplePlugins, whose AdjustRect goes over its
+** budget on every call and moves the window a pixel so we can tell it ran,
+** and sends it a few made-up gestures. Each of the first three should call
+** it once and then skip it for the rest of the gesture; after that third
+** overrun, it shouldn't be called at all.
+*/
+
+#include "stdafx.h"
+#include "GrappleBench.h"
+#include "../GrappleLib/Plugins.h"
+
+static const int MOTIONS = 5;
+static const int GESTURES = 4;
+
+// How many of a gesture's motion events should reach the plugin.
+static const int EXPECTED_CALLS[GESTURES] = { 1, 1, 1, 0 };
+
+// Sends one move gesture and returns how many of its motion events the
+// plugin answered.
+static int SendGesture(void)
+{
+	RECT rect = { 100, 100, 500, 400 };
+	POINT pt = { 300, 250 };
+	SendPluginEvent(GRAPPLE_EVENT_BEGIN, GRAPPLE_GESTURE_MOVE, NULL, pt, &rect);
+	int calls = 0;
+	for (int i = 0; i < MOTIONS; i++) {
+		pt.x += 10;
+		OffsetRect(&rect, 10, 0);
+		if (SendPluginEvent(GRAPPLE_EVENT_MOTION, GRAPPLE_GESTURE_MOVE, NULL, pt, &rect))
+			calls++;
+	}
+	SendPluginEvent(GRAPPLE_EVENT_END, GRAPPLE_GESTURE_MOVE, NULL, pt, &rect);
+	return calls;
+}
+
+int RunPluginCheck(int argc, TCHAR *argv[])
+{
+	TCHAR path[MAX_PATH];
+	if (argc > 0) {
+		_tcsncpy_s(path, MAX_PATH, argv[0], _TRUNCATE);
+	} else {
+		const DWORD length = GetModuleFileName(NULL, path, MAX_PATH);
+		TCHAR *slash = (length && length < MAX_PATH) ? _tcsrchr(path, TEXT('\\')) : NULL;
+		if (!slash) {
+			_tprintf(TEXT("plugins: can't find SlowPlugin.dll\n"));
+			return 1;
+		}
+		*slash = 0;
+		_tcscat_s(path, MAX_PATH, TEXT("\\SamplePlugins\\SlowPlugin.dll"));
+	}
+	if (!LoadPlugin(path)) {
+		_tprintf(TEXT("plugins: can't load %s\n"), path);
+		return 1;
+	}
+
+	int failures = 0;
+	for (int i = 0; i < GESTURES; i++) {
+		const int calls = SendGesture();
+		printf("gesture: %d  calls: %d of %d  expected: %d\n", i + 1, calls, MOTIONS,
+			EXPECTED_CALLS[i]);
+		if (calls != EXPECTED_CALLS[i])
+			failures++;
+	}
+	printf("gestures: %d  mismatches: %d\n", GESTURES, failures);
+	return failures ? 1 : 0;
+}
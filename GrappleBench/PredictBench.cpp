@@ -0,0 +1,200 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** PredictBench.cpp
+** Replays pointer motion through the motion predictor.
+**
+** Every sample goes through PredictPoint() with its recorded timestamp, and
+** the guess is scored against where the pointer really was one lead time
+** later, interpolating between the recorded samples. The same score for
+** the unpredicted pointer is what we're trying to beat. Pointer motion comes
+** from an evdev recording (relative motion only) or, without one, from a
+** fixed set of synthetic strokes sampled at 125 Hz.
+*/
+
+#include "stdafx.h"
+#include "GrappleBench.h"
+#include "../GrappleLib/Predict.h"
+#include "../Grapple/Evdev.h"
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+static const int DEFAULT_LEAD_MS = 16;
+static const LONGLONG SYNTHETIC_INTERVAL_US = 8000;
+static const double PI = 3.14159265358979323846;
+
+struct Sample {
+	LONGLONG timeUs;
+	POINT pt;
+};
+
+typedef std::vector<Sample> Samples;
+
+struct ErrorStats {
+	double mean, p95, max;
+};
+
+static LONG Round(double d)
+{
+	return (LONG)((d < 0.0) ? d - 0.5 : d + 0.5);
+}
+
+static void AddSample(Samples *samples, LONGLONG timeUs, double x, double y)
+{
+	Sample s;
+	s.timeUs = timeUs;
+	s.pt.x = Round(x);
+	s.pt.y = Round(y);
+	samples->push_back(s);
+}
+
+// One sample per frame that moved the pointer, at the frame's SYN_REPORT.
+static bool LoadRecording(const TCHAR *path, Samples *samples)
+{
+	FILE *f;
+	if (_tfopen_s(&f, path, TEXT("rb")) != 0)
+		return false;
+
+	LONG x = 0, y = 0;
+	bool hasMoved = false;
+	EvdevEvent e;
+	while (fread(&e, sizeof(EvdevEvent), 1, f) == 1) {
+		if (e.type == EV_REL && e.code == REL_X) {
+			x += e.value;
+			hasMoved = true;
+		} else if (e.type == EV_REL && e.code == REL_Y) {
+			y += e.value;
+			hasMoved = true;
+		} else if (e.type == EV_SYN && e.code == SYN_REPORT && hasMoved) {
+			AddSample(samples, e.sec * 1000000 + e.usec, x, y);
+			hasMoved = false;
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+// A fast straight drag, a slow circle, and a drag that speeds up, slows
+// down and stops, each followed by a pause.
+static void MakeSyntheticStrokes(Samples *samples)
+{
+	LONGLONG t = 0;
+	for (int i = 0; i <= 60; i++, t += SYNTHETIC_INTERVAL_US)
+		AddSample(samples, t, 100.0 + i * 20.0, 300.0 + i * 6.0);
+	t += 250000;
+	for (int i = 0; i <= 250; i++, t += SYNTHETIC_INTERVAL_US) {
+		const double a = 2.0 * PI * i / 250.0;
+		AddSample(samples, t, 600.0 + 200.0 * cos(a), 400.0 + 200.0 * sin(a));
+	}
+	t += 250000;
+	for (int i = 0; i <= 125; i++, t += SYNTHETIC_INTERVAL_US) {
+		const double s = 0.5 - 0.5 * cos(PI * i / 125.0);
+		AddSample(samples, t, 800.0 - 700.0 * s, 600.0 - 400.0 * s);
+	}
+	for (int i = 0; i < 30; i++, t += SYNTHETIC_INTERVAL_US)
+		AddSample(samples, t, 100.0, 200.0);
+}
+
+// Where the pointer was at timeUs, or false if that's past the end of the
+// recording. Queries have to come in time order; *cursor keeps our place.
+static bool PointerAt(const Samples &samples, size_t *cursor, LONGLONG timeUs,
+	double *x, double *y)
+{
+	while (*cursor + 1 < samples.size() && samples[*cursor + 1].timeUs <= timeUs)
+		(*cursor)++;
+	if (*cursor + 1 >= samples.size())
+		return false;
+
+	const Sample &a = samples[*cursor];
+	const Sample &b = samples[*cursor + 1];
+	const double f = (b.timeUs > a.timeUs) ?
+		(double)(timeUs - a.timeUs) / (double)(b.timeUs - a.timeUs) : 0.0;
+	*x = a.pt.x + f * (b.pt.x - a.pt.x);
+	*y = a.pt.y + f * (b.pt.y - a.pt.y);
+	return true;
+}
+
+static ErrorStats Summarize(std::vector<double> errors)
+{
+	ErrorStats stats = { 0.0, 0.0, 0.0 };
+	if (errors.empty())
+		return stats;
+
+	std::sort(errors.begin(), errors.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < errors.size(); i++)
+		sum += errors[i];
+	stats.mean = sum / errors.size();
+	stats.p95 = errors[(errors.size() - 1) * 95 / 100];
+	stats.max = errors.back();
+	return stats;
+}
+
+int RunPredictBench(int argc, TCHAR *argv[])
+{
+	const TCHAR *path = NULL;
+	int leadMs = DEFAULT_LEAD_MS;
+	for (int i = 0; i < argc; i++) {
+		if (_tcsnicmp(argv[i], TEXT("/lead:"), 6) == 0)
+			leadMs = _ttoi(argv[i] + 6);
+		else
+			path = argv[i];
+	}
+	if (leadMs <= 0) {
+		_tprintf(TEXT("predict: bad lead time\n"));
+		return 2;
+	}
+
+	Samples samples;
+	if (path) {
+		if (!LoadRecording(path, &samples)) {
+			_tprintf(TEXT("predict: can't open %s\n"), path);
+			return 1;
+		}
+	} else {
+		MakeSyntheticStrokes(&samples);
+	}
+	if (samples.size() < 2) {
+		_tprintf(TEXT("predict: not enough pointer motion\n"));
+		return 1;
+	}
+
+	// Time the predictor on its own first, then score what it said.
+	SetPredictionOptions(true, leadMs);
+	std::vector<POINT> predicted(samples.size());
+	LARGE_INTEGER frequency, begin, end;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&begin);
+	ResetPrediction(samples[0].pt, samples[0].timeUs);
+	predicted[0] = samples[0].pt;
+	for (size_t i = 1; i < samples.size(); i++)
+		predicted[i] = PredictPoint(samples[i].pt, samples[i].timeUs);
+	QueryPerformanceCounter(&end);
+	const double nsPerCall = (end.QuadPart - begin.QuadPart) * 1e9 /
+		(double)frequency.QuadPart / (double)samples.size();
+
+	std::vector<double> rawErrors, predictedErrors;
+	size_t cursor = 0;
+	for (size_t i = 0; i < samples.size(); i++) {
+		double x, y;
+		if (!PointerAt(samples, &cursor, samples[i].timeUs + leadMs * 1000, &x, &y))
+			break;
+		rawErrors.push_back(_hypot(samples[i].pt.x - x, samples[i].pt.y - y));
+		predictedErrors.push_back(_hypot(predicted[i].x - x, predicted[i].y - y));
+	}
+
+	const ErrorStats raw = Summarize(rawErrors);
+	const ErrorStats guess = Summarize(predictedErrors);
+	printf("samples: %u\n", (unsigned)samples.size());
+	printf("lead_ms: %d\n", leadMs);
+	printf("error_px:     mean     p95     max\n");
+	printf("unpredicted %7.2f %7.2f %7.2f\n", raw.mean, raw.p95, raw.max);
+	printf("predicted   %7.2f %7.2f %7.2f\n", guess.mean, guess.p95, guess.max);
+	printf("predict_ns_per_call: %.1f\n", nsPerCall);
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** TableBench.cpp
+** Hit-test timings for the window table.
+**
+** Made-up desktops of 1,000 and 10,000 small windows are scanned with both
+** the scalar and the vector hit test, with points spread over the screen so
+** most queries go deep into the table. Every query's answer from the vector
+** scan is checked against the scalar one, and the benchmark fails if any of
+** them disagree. Then the real desktop is queried three
+** ways: against a table we already have, rebuilding the table for every
+** query, and asking the system with WindowFromPoint().
+*/
+
+#include "stdafx.h"
+#include "GrappleBench.h"
+#include "../GrappleLib/WindowTable.h"
+
+static const int QUERY_COUNT = 20000;
+static const int SCREEN_WIDTH = 3000;
+static const int SCREEN_HEIGHT = 2000;
+static const int LIVE_QUERY_COUNT = 2000;
+
+// Too big for the stack.
+static WindowTable table;
+static POINT queries[QUERY_COUNT];
+static int scalarHits[QUERY_COUNT];
+static int vectorHits[QUERY_COUNT];
+
+// Same sequence on every run, so results are comparable.
+static DWORD seed = 1;
+
+static LONG Random(LONG range)
+{
+	seed = seed * 1103515245 + 12345;
+	return (LONG)((seed >> 8) % (DWORD)range);
+}
+
+static void MakeQueries(int count)
+{
+	for (int i = 0; i < count; i++) {
+		queries[i].x = Random(SCREEN_WIDTH);
+		queries[i].y = Random(SCREEN_HEIGHT);
+	}
+}
+
+static void MakeTable(int count)
+{
+	ResetWindowTable(&table);
+	for (int i = 0; i < count; i++) {
+		RECT r;
+		r.left = Random(SCREEN_WIDTH);
+		r.top = Random(SCREEN_HEIGHT);
+		r.right = r.left + 1 + Random(20);
+		r.bottom = r.top + 1 + Random(20);
+		AddTableWindow(&table, (HWND)(ULONG_PTR)(i + 1), &r);
+	}
+}
+
+static double Seconds(const LARGE_INTEGER &begin, const LARGE_INTEGER &end)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return (double)(end.QuadPart - begin.QuadPart) / (double)frequency.QuadPart;
+}
+
+// Returns how many queries the two hit tests disagreed on.
+static int BenchSynthetic(int windows)
+{
+	MakeTable(windows);
+	MakeQueries(QUERY_COUNT);
+
+	// Keep every answer, so neither loop can be optimized away and the two
+	// can be checked against each other query by query.
+	LARGE_INTEGER a, b, c;
+	QueryPerformanceCounter(&a);
+	for (int i = 0; i < QUERY_COUNT; i++)
+		scalarHits[i] = HitTestWindowTableScalar(&table, queries[i]);
+	QueryPerformanceCounter(&b);
+	for (int i = 0; i < QUERY_COUNT; i++)
+		vectorHits[i] = HitTestWindowTable(&table, queries[i]);
+	QueryPerformanceCounter(&c);
+
+	printf("windows: %d\n", windows);
+	printf("  scalar_us_per_query: %.3f\n", Seconds(a, b) * 1e6 / QUERY_COUNT);
+	printf("  vector_us_per_query: %.3f\n", Seconds(b, c) * 1e6 / QUERY_COUNT);
+
+	int mismatches = 0;
+	for (int i = 0; i < QUERY_COUNT; i++) {
+		if (scalarHits[i] == vectorHits[i])
+			continue;
+		if (mismatches++ == 0)
+			printf("  query %d at (%ld, %ld): scalar %d, vector %d\n", i,
+				queries[i].x, queries[i].y, scalarHits[i], vectorHits[i]);
+	}
+	printf("  mismatches: %d\n", mismatches);
+	return mismatches;
+}
+
+static void BenchLive(void)
+{
+	MakeQueries(LIVE_QUERY_COUNT);
+
+	LARGE_INTEGER a, b, c, d;
+	LONGLONG sum = 0;
+	const WindowTable *live = RefreshWindowTable();
+	const int windows = live->count;
+	QueryPerformanceCounter(&a);
+	for (int i = 0; i < LIVE_QUERY_COUNT; i++)
+		sum += HitTestWindowTable(live, queries[i]);
+	QueryPerformanceCounter(&b);
+	for (int i = 0; i < LIVE_QUERY_COUNT; i++)
+		sum += HitTestWindowTable(RefreshWindowTable(), queries[i]);
+	QueryPerformanceCounter(&c);
+	for (int i = 0; i < LIVE_QUERY_COUNT; i++)
+		sum += (LONGLONG)(ULONG_PTR)GetAncestor(WindowFromPoint(queries[i]), GA_ROOT);
+	QueryPerformanceCounter(&d);
+
+	printf("desktop windows: %d\n", windows);
+	printf("  cached_table_us_per_query: %.3f\n", Seconds(a, b) * 1e6 / LIVE_QUERY_COUNT);
+	printf("  rebuilt_table_us_per_query: %.3f\n", Seconds(b, c) * 1e6 / LIVE_QUERY_COUNT);
+	printf("  window_from_point_us_per_query: %.3f\n", Seconds(c, d) * 1e6 / LIVE_QUERY_COUNT);
+	printf("  (checksum %lld)\n", sum);
+}
+
+int RunTableBench(int argc, TCHAR *argv[])
+{
+	int failures = BenchSynthetic(1000);
+	failures += BenchSynthetic(10000);
+	BenchLive();
+	return failures ? 1 : 0;
+}
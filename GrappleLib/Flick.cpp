@@ -0,0 +1,146 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Flick.cpp
+** Recognizes quick, straight throws at the end of a move gesture.
+**
+** The window follows the pointer as usual while we watch, so ordinary drags
+** aren't held up. We never keep the whole path: just where and when the
+** gesture started, how far the pointer has travelled along the way, and a
+** small ring of the latest samples for measuring release speed. A flick is
+** short, fast right up to the release, and close to a straight line.
+*/
+
+#include "stdafx.h"
+#include "Flick.h"
+#include <cmath>
+#include <cstdlib>
+
+// Must be a power of two.
+static const int RING_SIZE = 8;
+
+static const double MAX_DURATION = 0.25;      // Seconds from press to release.
+static const double MIN_DISTANCE = 80.0;      // Pixels from press to release.
+static const double MIN_STRAIGHTNESS = 0.9;   // Distance over path length.
+static const double MIN_RELEASE_SPEED = 800;  // Pixels per second...
+static const double RELEASE_WINDOW = 0.06;    // ...over this many seconds before release.
+
+struct FlickSample {
+	POINT pt;
+	LONGLONG time;
+};
+
+// Gestures stay within one process, so these don't need to be shared.
+static FlickSample start;
+static FlickSample ring[RING_SIZE];
+static int ringCount = 0;
+static double pathLength = 0;
+static LONGLONG ticksPerSecond = 0;
+
+static LONGLONG Now(void)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+static double Distance(const POINT a, const POINT b)
+{
+	const double dx = (double)(b.x - a.x);
+	const double dy = (double)(b.y - a.y);
+	return sqrt(dx * dx + dy * dy);
+}
+
+static double Seconds(LONGLONG ticks)
+{
+	return (double)ticks / (double)ticksPerSecond;
+}
+
+static const FlickSample *Latest(void)
+{
+	return &ring[(ringCount - 1) & (RING_SIZE - 1)];
+}
+
+static void AddSample(const POINT pt, LONGLONG time)
+{
+	pathLength += Distance(Latest()->pt, pt);
+	FlickSample *sample = &ring[ringCount & (RING_SIZE - 1)];
+	sample->pt = pt;
+	sample->time = time;
+	ringCount++;
+}
+
+void BeginFlick(const POINT pt)
+{
+	if (!ticksPerSecond) {
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		ticksPerSecond = frequency.QuadPart;
+	}
+	start.pt = pt;
+	start.time = Now();
+	ring[0] = start;
+	ringCount = 1;
+	pathLength = 0;
+}
+
+void TrackFlick(const POINT pt)
+{
+	if (ringCount && (pt.x != Latest()->pt.x || pt.y != Latest()->pt.y))
+		AddSample(pt, Now());
+}
+
+// Speed over the last RELEASE_WINDOW seconds, measured from the oldest sample
+// in the ring that's still inside the window. Zero if the pointer had come to
+// rest before the button came up.
+static double GetReleaseSpeed(const FlickSample *end)
+{
+	const int oldest = (ringCount > RING_SIZE) ? ringCount - RING_SIZE : 0;
+	const FlickSample *from = NULL;
+	for (int i = ringCount - 2; i >= oldest; i--) {
+		const FlickSample *sample = &ring[i & (RING_SIZE - 1)];
+		if (Seconds(end->time - sample->time) > RELEASE_WINDOW)
+			break;
+		from = sample;
+	}
+	if (!from || end->time == from->time)
+		return 0;
+	return Distance(from->pt, end->pt) / Seconds(end->time - from->time);
+}
+
+static FlickDirection Classify(void)
+{
+	const FlickSample *end = Latest();
+	const double distance = Distance(start.pt, end->pt);
+	if (Seconds(end->time - start.time) > MAX_DURATION || distance < MIN_DISTANCE)
+		return FLICK_NONE;
+	if (distance < MIN_STRAIGHTNESS * pathLength)
+		return FLICK_NONE;
+	if (GetReleaseSpeed(end) < MIN_RELEASE_SPEED)
+		return FLICK_NONE;
+
+	// Diagonal throws are ambiguous, so they don't count.
+	const LONG dx = end->pt.x - start.pt.x;
+	const LONG dy = end->pt.y - start.pt.y;
+	if (abs(dx) >= 2 * abs(dy))
+		return (dx < 0) ? FLICK_LEFT : FLICK_RIGHT;
+	if (abs(dy) >= 2 * abs(dx))
+		return (dy < 0) ? FLICK_UP : FLICK_DOWN;
+	return FLICK_NONE;
+}
+
+FlickDirection EndFlick(const POINT pt)
+{
+	if (!ringCount)
+		return FLICK_NONE;
+	// Always take this sample, even if the pointer hasn't moved: how long it's
+	// been resting matters.
+	AddSample(pt, Now());
+	const FlickDirection direction = Classify();
+	ringCount = 0;
+	return direction;
+}
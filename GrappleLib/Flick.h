@@ -0,0 +1,29 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Flick.h
+** Recognizes quick, straight throws at the end of a move gesture.
+*/
+
+#pragma once
+
+enum FlickDirection {
+	FLICK_NONE,
+	FLICK_LEFT,
+	FLICK_RIGHT,
+	FLICK_UP,
+	FLICK_DOWN
+};
+
+// Start watching a move gesture that begins at pt.
+void BeginFlick(const POINT pt);
+
+// Feed in a pointer sample. Cheap enough to call on every mouse move.
+void TrackFlick(const POINT pt);
+
+// Decide, when the button comes up at pt, whether the gesture was a flick.
+FlickDirection EndFlick(const POINT pt);
@@ -0,0 +1,211 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** FreeSpace.cpp
+** Largest empty rectangle around a point.
+**
+** The best rectangle's top edge is either the top of the area or the bottom
+** of some obstacle above the point, so we try each of those in turn. For a
+** given top, the obstacles straddling the point's row fix how far left and
+** right we can go. We then sweep down through the obstacles below the point
+** in order of their top edges: each one either narrows the rectangle, ends
+** it (if it sits right below the point), or misses it entirely, and the
+** rectangle just above each one is a candidate. That's O(n) per top edge
+** and O(n^2) overall, which is well under a millisecond for a thousand
+** windows, and the inner loops are nothing but integer compares.
+*/
+
+#include "stdafx.h"
+#include "FreeSpace.h"
+#include <algorithm>
+#include <vector>
+
+static bool ByTop(const RECT &a, const RECT &b)
+{
+	return a.top < b.top;
+}
+
+struct StartsAtOrAbove {
+	LONG y;
+	explicit StartsAtOrAbove(LONG y) : y(y) {}
+	bool operator()(const RECT &r) const { return r.top <= y; }
+};
+
+static inline LONGLONG Area(LONG left, LONG top, LONG right, LONG bottom)
+{
+	return (LONGLONG)(right - left) * (LONGLONG)(bottom - top);
+}
+
+bool FindFreeSpace(RECT *obstacles, int count, const RECT *area, const POINT pt, RECT *result)
+{
+	if (pt.x < area->left || pt.x >= area->right || pt.y < area->top || pt.y >= area->bottom)
+		return false;
+
+	// Clip everything to the area and drop whatever we can't or needn't avoid.
+	int n = 0;
+	for (int i = 0; i < count; i++) {
+		RECT r = obstacles[i];
+		r.left = (std::max)(r.left, area->left);
+		r.top = (std::max)(r.top, area->top);
+		r.right = (std::min)(r.right, area->right);
+		r.bottom = (std::min)(r.bottom, area->bottom);
+		if (r.left >= r.right || r.top >= r.bottom)
+			continue;
+		if (pt.x >= r.left && pt.x < r.right && pt.y >= r.top && pt.y < r.bottom)
+			continue;
+		obstacles[n++] = r;
+	}
+
+	// Obstacles that start below the point's row go to the back, sorted by
+	// their top edges for the downward sweep.
+	RECT *below = std::partition(obstacles, obstacles + n, StartsAtOrAbove(pt.y));
+	const int aboveCount = (int)(below - obstacles);
+	const int belowCount = n - aboveCount;
+	std::sort(below, below + belowCount, ByTop);
+
+	*result = *area;
+	LONGLONG bestArea = -1;
+
+	// Candidate tops: the area's top plus the bottom of every obstacle that
+	// ends above the point's row.
+	for (int c = -1; c < aboveCount; c++) {
+		LONG top;
+		if (c < 0) {
+			top = area->top;
+		} else {
+			if (obstacles[c].bottom > pt.y)
+				continue;
+			top = obstacles[c].bottom;
+		}
+
+		// Obstacles reaching down past `top` overlap the rows from top to the
+		// point, so they bound us on the left or right. If one is directly
+		// above the point, this top edge is no good.
+		LONG left = area->left;
+		LONG right = area->right;
+		bool blocked = false;
+		for (int i = 0; i < aboveCount && !blocked; i++) {
+			const RECT &r = obstacles[i];
+			if (r.bottom <= top)
+				continue;
+			if (r.right <= pt.x)
+				left = (std::max)(left, r.right);
+			else if (r.left > pt.x)
+				right = (std::min)(right, r.left);
+			else
+				blocked = true;
+		}
+		if (blocked)
+			continue;
+
+		// Grow downwards, one obstacle at a time.
+		LONG bottom = area->bottom;
+		for (int i = 0; i < belowCount; i++) {
+			const RECT &r = below[i];
+			if (r.right <= left || r.left >= right)
+				continue;
+
+			// Everything above this obstacle is a candidate.
+			const LONGLONG a = Area(left, top, right, r.top);
+			if (a > bestArea) {
+				bestArea = a;
+				result->left = left;
+				result->top = top;
+				result->right = right;
+				result->bottom = r.top;
+			}
+
+			if (r.right <= pt.x) {
+				left = r.right;
+			} else if (r.left > pt.x) {
+				right = r.left;
+			} else {
+				bottom = r.top;
+				break;
+			}
+		}
+
+		const LONGLONG a = Area(left, top, right, bottom);
+		if (a > bestArea) {
+			bestArea = a;
+			result->left = left;
+			result->top = top;
+			result->right = right;
+			result->bottom = bottom;
+		}
+	}
+	return true;
+}
+
+static bool Overlaps(const RECT *obstacles, int count, LONG left, LONG top, LONG right, LONG bottom)
+{
+	for (int i = 0; i < count; i++) {
+		const RECT &r = obstacles[i];
+		if (r.left < right && r.right > left && r.top < bottom && r.bottom > top)
+			return true;
+	}
+	return false;
+}
+
+bool FindFreeSpaceExhaustive(const RECT *obstacles, int count, const RECT *area,
+	const POINT pt, RECT *result)
+{
+	if (pt.x < area->left || pt.x >= area->right || pt.y < area->top || pt.y >= area->bottom)
+		return false;
+
+	// Same clipping and dropping as FindFreeSpace(), but into a copy.
+	std::vector<RECT> kept;
+	for (int i = 0; i < count; i++) {
+		RECT r = obstacles[i];
+		r.left = (std::max)(r.left, area->left);
+		r.top = (std::max)(r.top, area->top);
+		r.right = (std::min)(r.right, area->right);
+		r.bottom = (std::min)(r.bottom, area->bottom);
+		if (r.left >= r.right || r.top >= r.bottom)
+			continue;
+		if (pt.x >= r.left && pt.x < r.right && pt.y >= r.top && pt.y < r.bottom)
+			continue;
+		kept.push_back(r);
+	}
+
+	// The best rectangle's edges each lie on the area's edge or an obstacle's
+	// edge, on the right side of the point. Try every combination.
+	std::vector<LONG> lefts(1, area->left), tops(1, area->top);
+	std::vector<LONG> rights(1, area->right), bottoms(1, area->bottom);
+	for (size_t i = 0; i < kept.size(); i++) {
+		if (kept[i].right <= pt.x)
+			lefts.push_back(kept[i].right);
+		if (kept[i].left > pt.x)
+			rights.push_back(kept[i].left);
+		if (kept[i].bottom <= pt.y)
+			tops.push_back(kept[i].bottom);
+		if (kept[i].top > pt.y)
+			bottoms.push_back(kept[i].top);
+	}
+
+	const RECT *first = kept.empty() ? NULL : &kept[0];
+	const int n = (int)kept.size();
+	LONGLONG bestArea = -1;
+	for (size_t l = 0; l < lefts.size(); l++) {
+		for (size_t r = 0; r < rights.size(); r++) {
+			for (size_t t = 0; t < tops.size(); t++) {
+				for (size_t b = 0; b < bottoms.size(); b++) {
+					const LONGLONG a = Area(lefts[l], tops[t], rights[r], bottoms[b]);
+					if (a <= bestArea ||
+							Overlaps(first, n, lefts[l], tops[t], rights[r], bottoms[b]))
+						continue;
+					bestArea = a;
+					result->left = lefts[l];
+					result->top = tops[t];
+					result->right = rights[r];
+					result->bottom = bottoms[b];
+				}
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,24 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** FreeSpace.h
+** Largest empty rectangle around a point.
+*/
+
+#pragma once
+
+// Finds the largest rectangle inside `area` that contains pt and doesn't
+// overlap any of the obstacles. Obstacles that contain pt can't be avoided
+// and are ignored. The obstacle array is used as scratch space and comes
+// back clipped and reordered. Returns false if pt isn't inside `area`.
+bool FindFreeSpace(RECT *obstacles, int count, const RECT *area, const POINT pt, RECT *result);
+
+// Same as FindFreeSpace(), by trying every combination of edges. That's
+// O(n^5), so it's only fit for checking FindFreeSpace() against on layouts
+// with a handful of obstacles. Leaves the obstacles alone.
+bool FindFreeSpaceExhaustive(const RECT *obstacles, int count, const RECT *area,
+	const POINT pt, RECT *result);
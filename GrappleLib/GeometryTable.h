@@ -0,0 +1,98 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** GeometryTable.h
+** Window placement table shared between GrappleLib and Grapple.exe.
+**
+** Grapple.exe owns the table. It's kept in GrappleGeometry.dat and mapped
+** under GEOMETRY_MAPPING, so the hooks can look new windows up from inside
+** the process that creates them. Grapple.exe may be rewriting an entry (even
+** handing its slot to another application) while a hook reads it, so each
+** entry has a sequence number that's odd while a write is in progress, and
+** readers outside Grapple.exe go through ReadGeometryEntry().
+*/
+
+#pragma once
+
+static const TCHAR *GEOMETRY_MAPPING = TEXT("GrappleGeometry");
+static const DWORD GEOMETRY_MAGIC = 0x4d454f47;  // "GEOM"
+static const DWORD GEOMETRY_VERSION = 2;
+
+// Must be a power of two.
+static const DWORD GEOMETRY_CAPACITY = 1024;
+static const DWORD MAX_PROBES = 16;
+
+struct GeometryEntry {
+	ULONGLONG key;       // Zero if the slot is free.
+	RECT rect;           // Restored position, in workspace coordinates.
+	DWORD isMaximized;
+	DWORD stamp;         // Bumped on every write, so we can evict the stalest.
+	volatile LONG seq;   // Odd while the entry is being written.
+};
+
+struct GeometryTable {
+	DWORD magic;
+	DWORD version;
+	DWORD capacity;
+	DWORD stamp;
+	GeometryEntry entries[GEOMETRY_CAPACITY];
+};
+
+inline void FoldGeometryHash(ULONGLONG *hash, TCHAR c)
+{
+	const ULONGLONG FNV_PRIME = 1099511628211ULL;
+	*hash = (*hash ^ (ULONGLONG)(c & 0xff)) * FNV_PRIME;
+	*hash = (*hash ^ (ULONGLONG)((c >> 8) & 0xff)) * FNV_PRIME;
+}
+
+// 64-bit FNV-1a hash of the lowercased executable file name (only the part
+// of path after the last backslash) plus the window class. Never zero.
+inline ULONGLONG GetGeometryKey(const TCHAR *path, const TCHAR *className)
+{
+	const TCHAR *name = path;
+	for (const TCHAR *p = path; *p; p++) {
+		if (*p == TEXT('\\'))
+			name = p + 1;
+	}
+
+	ULONGLONG hash = 14695981039346656037ULL;
+	for (const TCHAR *p = name; *p; p++)
+		FoldGeometryHash(&hash, (TCHAR)_totlower(*p));
+	FoldGeometryHash(&hash, TEXT('|'));
+	for (const TCHAR *p = className; *p; p++)
+		FoldGeometryHash(&hash, *p);
+	return hash ? hash : 1;
+}
+
+inline const GeometryEntry *FindGeometryEntry(const GeometryTable *table, ULONGLONG key)
+{
+	for (DWORD i = 0; i < MAX_PROBES; i++) {
+		const GeometryEntry *entry = &table->entries[(key + i) & (GEOMETRY_CAPACITY - 1)];
+		if (entry->key == key)
+			return entry;
+		if (!entry->key)
+			return NULL;
+	}
+	return NULL;
+}
+
+// Copies out the entry for key, making sure it was neither half-written nor
+// given to some other key while we copied it. Returns false if there's no
+// such entry, or if it was being written; the caller can just go without.
+inline bool ReadGeometryEntry(const GeometryTable *table, ULONGLONG key, GeometryEntry *copy)
+{
+	const GeometryEntry *entry = FindGeometryEntry(table, key);
+	if (!entry)
+		return false;
+	const LONG seq = entry->seq;
+	if (seq & 1)
+		return false;
+	MemoryBarrier();
+	*copy = *entry;
+	MemoryBarrier();
+	return entry->seq == seq && copy->key == key;
+}
@@ -27,6 +27,77 @@
 ** - There is currently no way to blacklist misbehaving applications from
 **   Grapple's influence.
 **
+** 3.3:
+** > Optional timeline tracing. Hook entry, window resolution, placement calls,
+**   enumeration and key handling are recorded as spans into a shared ring
+**   buffer, which can be saved from the tray menu as Chrome trace-event JSON
+**   and opened in chrome://tracing.
+** > Grapple.exe serves a local control pipe (\\.\pipe\Grapple) that takes
+**   batches of move, resize, set-rectangle, send-to-back and query commands in
+**   a compact binary format (see ControlProtocol.h). Each batch is applied as
+**   a single deferred window positioning transaction.
+** > Move and resize no longer read the window's placement back on every
+**   mouse move. It is captured once when the gesture starts. Placement
+**   updates for windows owned by another thread are posted asynchronously
+**   (on Vista and later) rather than waiting on that thread each time.
+** > Optional motion prediction (tray menu). While moving or resizing, the
+**   window is placed where the cursor is expected to be by the time the
+**   application repaints, and settles back under the cursor once motion
+**   stops.
+** > ALT-dragging a window also drags its visible owned windows (tool
+**   palettes, owned popups) along with it. The set is collected once when
+**   the move starts and every frame is applied as one deferred batch.
+** > ALT+Z undoes the last move, resize, flick or send-to-back, and
+**   ALT+SHIFT+Z redoes it. The last 64 gestures are kept in a fixed journal
+**   shared by all hooked processes.
+** > Added a z-ordered table of window rectangles with a vectorized (SSE2 or
+**   AVX2) point-in-rectangle scan, for finding the window under a point
+**   without going back to the system. Used when a mouse message arrives
+**   without a window handle. Each process keeps its table until Grapple.exe
+**   sees a top-level window change, rather than rebuilding it every time.
+** > ALT+double-click grows a window to fill the largest empty space on its
+**   monitor around the cursor, avoiding every other visible window.
+** > Grapple.exe watches over the hooks. Every hook call bumps a shared
+**   heartbeat and times itself; when calls run close to the latency budget
+**   (10 ms, or /budget:<ms> on the command line) motion prediction and group
+**   dragging are paused until things calm down, and hooks that stop seeing
+**   input while the mouse is moving are reinstalled. Both are reported with
+**   a tray balloon.
+** > Grapple remembers where each application's windows were last put (by
+**   executable and window class) in GrappleGeometry.dat, and puts new
+**   windows of that kind back there. A CBT hook changes where the window is
+**   created, so it's never shown anywhere else; Grapple.exe maximizes the
+**   ones that were maximized when they're first shown. Hooks tell
+**   Grapple.exe when a move or resize ends with a posted message.
+** > ALT+flick: a quick, straight ALT-drag that's still moving when the
+**   button comes up throws the window to the left or right half of the
+**   work area, maximizes it (up), or sends it to the next monitor (down).
+**   Ordinary drags behave exactly as before.
+** > When ALT goes down, the keyboard hook looks up the window under the
+**   cursor (its tangible window, placement and constraints) ahead of time,
+**   so the first ALT+click can start a gesture without any lookups. It's
+**   thrown away if the window has moved or changed size by then. Traces
+**   record the time from button-down to the first window update as
+**   FirstMotion or FirstMotionPrefetched.
+** > Plugins. DLLs in a Plugins folder next to GrappleLib.dll can watch
+**   gestures and adjust where windows go (for snapping, layouts and so on).
+**   See GrapplePlugin.h. Plugins that take too long are skipped. Each
+**   process loads them from the first mouse input outside a gesture.
+** > Send-to-back now activates the window that was active most recently
+**   (outside the sent-back window's owner group), like ALT+TAB would, from
+**   a list kept up to date as the foreground changes. The z-order walk is
+**   only a fallback.
+** > Send-to-back works out which windows actually come into view under the
+**   sent-back window, and activates one of those (the most recently active,
+**   else the one that shows the most). Grapple.exe can outline the part that
+**   will be revealed while the middle button is held (tray menu). The
+**   middle button is captured like the other gestures, and the outline comes
+**   down when ALT does.
+** > Grapple.exe /replay:<file> plays back a recording of evdev-format pointer
+**   and key events through SendInput() as fast as it will go, then writes
+**   the input rate and the time our hooks added per call to
+**   GrappleReplay.txt and quits. Meant for benchmarking unattended.
+**
 ** 3.2:
 ** > Smarter detection of "tangible" windows that should be selected for move
 **   and resize operations.
@@ -82,14 +153,68 @@
 
 #include "stdafx.h"
 #include "GrappleLib.h"
+#include "Flick.h"
+#include "FreeSpace.h"
+#include "Health.h"
+#include "Journal.h"
+#include "Mru.h"
+#include "Plugins.h"
+#include "Predict.h"
+#include "Restore.h"
+#include "Reveal.h"
+#include "Trace.h"
+#include "WindowTable.h"
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
 #define QUASIMODE VK_MENU    // ALT key.
+#define UNDO_KEY 'Z'         // ALT+Z undoes, ALT+SHIFT+Z redoes.
+
+#ifndef WPF_ASYNCWINDOWPLACEMENT
+#define WPF_ASYNCWINDOWPLACEMENT 0x0004
+#endif
 
 static const int ERROR_STRING_SIZE = 1024;
 
+// Variables placed in the .shared data segment are visible to every process
+// our hooks are loaded into, instead of each process getting its own copy.
+#pragma comment(linker, "/SECTION:.shared,RWS")
+
+// What a gesture needs to know about its window before it can start.
+struct TargetInfo {
+	HWND tangible;
+	WINDOWPLACEMENT placement;
+	bool isFullScreen;
+	bool isResizable;
+};
+
+// What the keyboard hook found under the cursor when ALT went down. It's
+// written by whichever process has the focus and read by whichever process
+// gets the click, so it's shared, and guarded by a sequence number that's
+// odd while a write is in progress.
+struct Prefetch {
+	HWND target;         // The window under the cursor. NULL if there's nothing.
+	DWORD time;          // GetTickCount() when we looked.
+	RECT rect;           // Where the tangible window was then.
+	TargetInfo info;
+};
+
+// Where to post a message when a gesture ends, so Grapple.exe can take note
+// of the window's new placement.
+#pragma data_seg(".shared")
+static HWND notifyWnd = NULL;
+static UINT notifyMsg = 0;
+static volatile LONG prefetchSeq = 0;
+static Prefetch prefetch = { NULL };
+static HWND previewWnd = NULL;
+static UINT previewMsg = 0;
+static volatile LONG isPreviewShown = 0;
+#pragma data_seg()
+
+// A prefetch older than this is more likely stale than useful.
+static const DWORD PREFETCH_MAX_AGE_MS = 2000;
+
 static HANDLE dllHandle;
 
 static bool isMouseHookInstalled = false;
@@ -101,6 +226,16 @@ static bool quasimodeNeedsKeyUp = false;
 
 static bool inSendBackState = false;
 
+// The window a send-to-back is for, and the window we hold mouse capture on
+// until the button comes back up. Both are picked when the button goes down.
+static HWND sendBackWindow = NULL;
+static HWND sendBackCapture = NULL;
+
+// The window a send-to-back will activate, picked when the button goes down.
+static const int MAX_REVEALED = 256;
+static RevealedWindow revealed[MAX_REVEALED];
+static HWND revealTarget = NULL;
+
 static bool inMoveState = false;
 enum ResizeEnum { NONE, TOPLEFT, TOPRIGHT, BOTLEFT, BOTRIGHT };
 static ResizeEnum resizeState = NONE;
@@ -109,8 +244,57 @@ static POINT wndref, mouseref;
 static RECT wndrectref;
 static HWND hwndref;
 
+// Placement of hwndref when the gesture started. Motion events start from
+// this instead of asking the window for its placement every time.
+static WINDOWPLACEMENT placementref;
+
+// The normal position we last gave hwndref, so that the journal can record
+// where a gesture left the window without having to ask the window.
+static RECT placedRect;
+
+// Where hwndref was on screen when the gesture started. Asking the window
+// later isn't the same: asynchronous placements may not have caught up yet.
+static RECT startRect;
+
+// Whether hwndref can be resized, decided once when the gesture starts.
+static bool isResizableRef;
+
+// When the current gesture's button went down, for tracing how long it takes
+// to get the window moving, and whether that was with prefetched information.
+static LONGLONG firstMotionBegin = 0;
+static bool isFirstMotionPrefetched = false;
+
+// When prediction has placed the window ahead of the pointer, this timer puts
+// it back under the pointer if no more motion arrives.
+static const UINT SETTLE_DELAY_MS = 40;
+static UINT_PTR settleTimer = 0;
+static POINT settlePoint;
+
+// Owned windows that travel along with hwndref during a move, with their
+// screen positions and their placements (for the journal) when the move
+// started.
+static const int MAX_GROUP_SIZE = 32;
+static HWND groupWindows[MAX_GROUP_SIZE];
+static POINT groupRefs[MAX_GROUP_SIZE];
+static WINDOWPLACEMENT groupPlacements[MAX_GROUP_SIZE];
+static int groupSize = 0;
+static POINT ownerRef;
+
+// The last ALT+left-click, for spotting double-clicks ourselves. Windows
+// without CS_DBLCLKS never get told about them.
+static HWND lastClickWindow = NULL;
+static DWORD lastClickTime;
+static POINT lastClickPoint;
+static bool swallowLButtonUp = false;
+
+// Windows we're willing to grow around, beyond the tangible window itself.
+static RECT freeSpaceObstacles[MAX_TABLE_WINDOWS];
+
 LRESULT WINAPI CALLBACK MouseProc(int nCode, WPARAM wParam, LPARAM lParam);
 LRESULT WINAPI CALLBACK KbProc(int nCode, WPARAM wParam, LPARAM lParam);
+static void PrefetchTarget(void);
+static void ClearPrefetch(void);
+static void HideRevealPreview(void);
 
 
 static void Complain(const TCHAR *s)
@@ -173,19 +357,24 @@ BOOL APIENTRY DllMain(HMODULE hModule,DWORD ul_reason_for_call, LPVOID lpReserve
 	case DLL_PROCESS_ATTACH:
 	case DLL_THREAD_ATTACH:
 	case DLL_THREAD_DETACH:
+		break;
 	case DLL_PROCESS_DETACH:
+		CloseTrace();
+		CloseRestore();
 		break;
 	}
     return TRUE;
 }
 
-GRAPPLELIB_API bool WINAPI InstallHook(void)
+// Installs whichever hooks aren't installed yet. Unless isQuiet is set, says
+// so in a message box when one can't be.
+static bool InstallHooks(const bool isQuiet)
 {
 	if (!isMouseHookInstalled) {
 		mouseHook = SetWindowsHookEx(WH_MOUSE, MouseProc, (HINSTANCE)dllHandle, 0);
 		if (mouseHook) {
 			isMouseHookInstalled = true;
-		} else {
+		} else if (!isQuiet) {
 			Complain(TEXT("Could not install the global mouse hook."));
 		}
 	}
@@ -193,15 +382,27 @@ GRAPPLELIB_API bool WINAPI InstallHook(void)
 		kbHook = SetWindowsHookEx(WH_KEYBOARD, KbProc, (HINSTANCE)dllHandle, 0);
 		if (kbHook) {
 			isKbHookInstalled = true;
-		} else {
+		} else if (!isQuiet) {
 			Complain(TEXT("Could not install the global keyboard hook."));
 		}
 	}
+
+	// Not fatal: send-to-back falls back to walking the z-order, and window
+	// tables get rebuilt every time they're used.
+	StartMru();
+	StartWindowTableEvents();
 	return isMouseHookInstalled && isKbHookInstalled;
 }
 
+GRAPPLELIB_API bool WINAPI InstallHook(void)
+{
+	return InstallHooks(false);
+}
+
 GRAPPLELIB_API void WINAPI RemoveHook(void)
 {
+	StopMru();
+	StopWindowTableEvents();
 	if (isKbHookInstalled) {
 		UnhookWindowsHookEx(kbHook);
 		isKbHookInstalled = false;
@@ -212,6 +413,105 @@ GRAPPLELIB_API void WINAPI RemoveHook(void)
 	}
 }
 
+// Puts the hooks back after Windows has dropped them. This is for the
+// watchdog, which runs from a timer and reports failure from the tray icon,
+// so a message box here would only pile up behind the next tick.
+GRAPPLELIB_API bool WINAPI ReinstallHook(void)
+{
+	RemoveHook();
+	return InstallHooks(true);
+}
+
+GRAPPLELIB_API bool WINAPI EnableTrace(bool enable)
+{
+	return SetTracing(enable);
+}
+
+GRAPPLELIB_API bool WINAPI SaveTrace(const TCHAR *path)
+{
+	return WriteTrace(path);
+}
+
+GRAPPLELIB_API void WINAPI SetPrediction(bool enable, int leadMs)
+{
+	SetPredictionOptions(enable, leadMs);
+}
+
+GRAPPLELIB_API void WINAPI GetHookHealth(HookHealth *health)
+{
+	ReadHealth(health);
+}
+
+GRAPPLELIB_API void WINAPI SetHookBudget(LONG budgetUs, bool shed)
+{
+	SetHealthOptions(budgetUs, shed);
+}
+
+GRAPPLELIB_API void WINAPI SetNotifyWindow(HWND hwnd, UINT msg)
+{
+	notifyMsg = msg;
+	notifyWnd = hwnd;
+}
+
+GRAPPLELIB_API void WINAPI SetRevealPreview(HWND hwnd, UINT msg)
+{
+	previewMsg = msg;
+	previewWnd = hwnd;
+}
+
+GRAPPLELIB_API bool WINAPI SetGeometryRestore(bool enable)
+{
+	if (!enable) {
+		StopRestore();
+		return true;
+	}
+	return StartRestore((HINSTANCE)dllHandle);
+}
+
+// For Grapple.exe, which reorders windows for control pipe clients and has
+// to tell the hooks' tables like we do for our own send-to-backs.
+GRAPPLELIB_API void WINAPI InvalidateTables(void)
+{
+	InvalidateWindowTables();
+}
+
+// Ask Grapple.exe to outline r, in screen coordinates, or to take the
+// outline down if r is empty.
+static void ShowRevealPreview(const RECT *r)
+{
+	InterlockedExchange(&isPreviewShown, IsRectEmpty(r) ? 0 : 1);
+	if (previewWnd)
+		PostMessage(previewWnd, previewMsg, MAKEWPARAM(r->left, r->top), MAKELPARAM(r->right, r->bottom));
+}
+
+// Take the outline down, if any process put one up. The send-to-back and its
+// outline may be in different processes from whoever sees ALT come up.
+static void HideRevealPreview(void)
+{
+	if (isPreviewShown) {
+		RECT none;
+		SetRectEmpty(&none);
+		ShowRevealPreview(&none);
+	}
+}
+
+// Ends a send-to-back, whether or not it happened.
+static void EndSendBack(void)
+{
+	HideRevealPreview();
+	revealTarget = NULL;
+	sendBackWindow = NULL;
+	sendBackCapture = NULL;
+	inSendBackState = false;
+}
+
+// Tell Grapple.exe that we just finished placing hwnd.
+static void NotifyGestureEnd(const HWND hwnd)
+{
+	if (notifyWnd)
+		PostMessage(notifyWnd, notifyMsg, (WPARAM)hwnd, 0);
+}
+
 // Returns the highest-level owner the specified window handle can be
 // traced to. If the given handle has no owner, returns hwnd.
 static HWND GetOwnerWindow(HWND hwnd)
@@ -289,6 +589,24 @@ static bool CanBringToTop(HWND hwnd)
 	return IsAltTabWindow(hwnd);
 }
 
+// Sends a window to the bottom of the z-order and records it in the journal.
+// `above` is whatever was directly above it beforehand.
+static void SendWindowToBack(HWND sbwnd, HWND above)
+{
+	const bool wasTopmost = IsSet(GetWindowLong(sbwnd, GWL_EXSTYLE), WS_EX_TOPMOST);
+	SetWindowPos(sbwnd, HWND_BOTTOM, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+	InvalidateWindowTables();
+	JournalSendToBack(sbwnd, above, wasTopmost);
+}
+
+// Brings hwnd to the top in place of sbwnd, which goes to the back.
+static void ReplaceOnTop(HWND sbwnd, HWND hwnd)
+{
+	const HWND above = GetWindow(sbwnd, GW_HWNDPREV);
+	BringWindowToTop(hwnd);
+	SendWindowToBack(sbwnd, above);
+}
+
 // Enumerate over all desktop windows so we can bring the next-highest
 // window in the z-order to the foreground and activate it.
 static BOOL WINAPI CALLBACK EnumWindowsProc(HWND hwnd, LPARAM lParam)
@@ -298,13 +616,73 @@ static BOOL WINAPI CALLBACK EnumWindowsProc(HWND hwnd, LPARAM lParam)
 	const HWND sbowner = GetOwnerWindow(sbwnd);
 
 	if (CanBringToTop(hwnd) && (owner != sbowner)) {
-		BringWindowToTop(hwnd);
-		SetWindowPos(sbwnd, HWND_BOTTOM, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+		ReplaceOnTop(sbwnd, hwnd);
 		return FALSE;
 	}
 	return TRUE;
 }
 
+// Picks the window to activate when sbwnd goes to the back from the ones that
+// will come into view: the most recently active, or failing that the one
+// that shows the most. Also returns the part of it that will show. Returns
+// NULL if nothing suitable comes into view.
+static HWND ChooseRevealedWindow(const HWND sbwnd, RECT *outline)
+{
+	SetRectEmpty(outline);
+	if (IsShedding())
+		return NULL;
+	TraceSpan span(TRACE_REVEAL);
+	const int count = ComputeReveal(GetWindowTable(), sbwnd, revealed, MAX_REVEALED);
+	if (count <= 0)
+		return NULL;
+
+	HWND windows[MRU_SIZE];
+	const int mruCount = GetMruWindows(windows, MRU_SIZE);
+	const HWND sbowner = GetOwnerWindow(sbwnd);
+	int best = -1;
+	int bestRank = MRU_SIZE;
+	for (int i = 0; i < count; i++) {
+		const HWND hwnd = revealed[i].hwnd;
+		if (GetOwnerWindow(hwnd) == sbowner || !CanBringToTop(hwnd))
+			continue;
+		int rank = MRU_SIZE;
+		for (int j = 0; j < mruCount; j++) {
+			if (windows[j] == hwnd) {
+				rank = j;
+				break;
+			}
+		}
+		if (best < 0 || rank < bestRank ||
+				(rank == bestRank && revealed[i].area > revealed[best].area)) {
+			best = i;
+			bestRank = rank;
+		}
+	}
+	if (best < 0)
+		return NULL;
+	*outline = revealed[best].bounds;
+	return revealed[best].hwnd;
+}
+
+// Sends sbwnd to the back and activates the window that was active most
+// recently before it, outside its owner group. Usually that's the first or
+// second entry in the list. Returns false if the list has nothing suitable.
+static bool SendToBackByMru(HWND sbwnd)
+{
+	HWND windows[MRU_SIZE];
+	const int count = GetMruWindows(windows, MRU_SIZE);
+	const HWND sbowner = GetOwnerWindow(sbwnd);
+	for (int i = 0; i < count; i++) {
+		const HWND hwnd = windows[i];
+		if (hwnd != sbwnd && IsWindow(hwnd) && GetOwnerWindow(hwnd) != sbowner &&
+				CanBringToTop(hwnd)) {
+			ReplaceOnTop(sbwnd, hwnd);
+			return true;
+		}
+	}
+	return false;
+}
+
 // Returns the difference of two POINTs a-b.
 static POINT SubtractPoints(const POINT a, const POINT b)
 {
@@ -314,13 +692,94 @@ static POINT SubtractPoints(const POINT a, const POINT b)
 	return c;
 }
 
-// Drags a window based on the new mouse point.
-static void DragWindow(const HWND hwnd, const POINT pt)
+// If the window belongs to some other thread (e.g. a browser frame whose
+// plugin child got the click), SetWindowPlacement() would block on that
+// thread for every mouse move. Ask for the update to be posted instead.
+// Only Vista and later understand WPF_ASYNCWINDOWPLACEMENT.
+static UINT GetPlacementFlags(const HWND hwnd)
+{
+	if (GetWindowThreadProcessId(hwnd, NULL) == GetCurrentThreadId())
+		return 0;
+	if (LOBYTE(LOWORD(GetVersion())) < 6)
+		return 0;
+	return WPF_ASYNCWINDOWPLACEMENT;
+}
+
+// Remember the placement of the window a gesture is about to move or resize.
+static void BeginPlacement(const HWND hwnd, const WINDOWPLACEMENT *placement)
 {
-	const POINT change = SubtractPoints(pt, mouseref);
+	hwndref = hwnd;
+	placementref = *placement;
+	placementref.flags |= GetPlacementFlags(hwnd);
+	placedRect = placement->rcNormalPosition;
+	if (!GetWindowRect(hwnd, &startRect))
+		SetRectEmpty(&startRect);
+}
+
+static BOOL WINAPI CALLBACK CollectOwnedProc(HWND hwnd, LPARAM lParam)
+{
+	const HWND owner = (HWND)lParam;
 	WINDOWPLACEMENT pl;
 	pl.length = sizeof(WINDOWPLACEMENT);
-	GetWindowPlacement(hwnd, &pl);
+	if (hwnd != owner && IsWindowVisible(hwnd) && !IsMinimized(hwnd) &&
+			!IsZoomed(hwnd) && GetOwnerWindow(hwnd) == owner &&
+			GetWindowPlacement(hwnd, &pl)) {
+		RECT r;
+		GetWindowRect(hwnd, &r);
+		groupWindows[groupSize] = hwnd;
+		groupRefs[groupSize].x = r.left;
+		groupRefs[groupSize].y = r.top;
+		groupPlacements[groupSize] = pl;
+		groupSize++;
+	}
+	return groupSize < MAX_GROUP_SIZE;
+}
+
+// Find the visible windows owned by hwnd so that they can be moved with it.
+// Only done when hwnd is a root owner: dragging a palette by itself should
+// just move the palette.
+static void BeginGroup(const HWND hwnd)
+{
+	groupSize = 0;
+	if (IsShedding() || GetOwnerWindow(hwnd) != hwnd)
+		return;
+
+	{
+		TraceSpan span(TRACE_ENUMERATE);
+		EnumWindows(CollectOwnedProc, (LPARAM)hwnd);
+	}
+	if (groupSize > 0) {
+		RECT r;
+		GetWindowRect(hwnd, &r);
+		ownerRef.x = r.left;
+		ownerRef.y = r.top;
+	}
+}
+
+// Moves hwndref and its owned windows as a single batch, so they all land in
+// the same frame. Everything is in screen coordinates here, unlike the
+// workspace coordinates DragWindow() normally uses. Returns false if the
+// batch failed, e.g. because one of the owned windows went away.
+static bool DragGroup(const POINT change)
+{
+	const UINT flags = SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE | SWP_NOOWNERZORDER;
+	HDWP dwp = BeginDeferWindowPos(groupSize + 1);
+	if (dwp)
+		dwp = DeferWindowPos(dwp, hwndref, NULL,
+			ownerRef.x + change.x, ownerRef.y + change.y, 0, 0, flags);
+	for (int i = 0; dwp && i < groupSize; i++)
+		dwp = DeferWindowPos(dwp, groupWindows[i], NULL,
+			groupRefs[i].x + change.x, groupRefs[i].y + change.y, 0, 0, flags);
+	return dwp && EndDeferWindowPos(dwp);
+}
+
+// Drags a window based on the new mouse point.
+static void DragWindow(const HWND hwnd, const POINT pt)
+{
+	TraceSpan span(TRACE_PLACEMENT);
+	POINT change = SubtractPoints(pt, mouseref);
+
+	WINDOWPLACEMENT pl = placementref;
 	RECT r = pl.rcNormalPosition;
 
 	const int w = r.right - r.left;
@@ -330,8 +789,25 @@ static void DragWindow(const HWND hwnd, const POINT pt)
 	r.right = r.left + w;
 	r.bottom = r.top + h;
 
+	if (SendPluginEvent(GRAPPLE_EVENT_MOTION, GRAPPLE_GESTURE_MOVE, hwnd, pt, &r)) {
+		change.x = r.left - wndref.x;
+		change.y = r.top - wndref.y;
+	}
+
+	if (groupSize > 0) {
+		if (DragGroup(change)) {
+			placedRect = placementref.rcNormalPosition;
+			OffsetRect(&placedRect, change.x, change.y);
+			return;
+		}
+
+		// Carry on moving just the one window.
+		groupSize = 0;
+	}
+
 	pl.rcNormalPosition = r;
 	SetWindowPlacement(hwnd, &pl);
+	placedRect = r;
 	
 	// Don't activate window when moving.
 	//SetWindowPos(hwnd, 0, d.x, d.y, 0, 0, SWP_NOSIZE | SWP_NOZORDER /* | SWP_NOACTIVATE */);
@@ -352,14 +828,13 @@ static bool IsResizable(const HWND hwnd)
 // Resizes a window based on the new mouse point.
 static void ResizeWindow(const HWND hwnd, const POINT pt)
 {
-	if (!IsResizable(hwnd))
+	TraceSpan span(TRACE_PLACEMENT);
+	if (!isResizableRef)
 		return;
 	POINT change = SubtractPoints(pt, mouseref);
 	RECT wndrect = wndrectref;
 	
-	WINDOWPLACEMENT pl;
-	pl.length = sizeof(WINDOWPLACEMENT);
-	GetWindowPlacement(hwnd, &pl);
+	WINDOWPLACEMENT pl = placementref;
 	pl.rcNormalPosition = wndrect;
 
 	switch (resizeState) {
@@ -381,28 +856,117 @@ static void ResizeWindow(const HWND hwnd, const POINT pt)
 	default:
 		break;
 	}
+	SendPluginEvent(GRAPPLE_EVENT_MOTION, GRAPPLE_GESTURE_RESIZE, hwnd, pt, &pl.rcNormalPosition);
 	SetWindowPlacement(hwnd, &pl);
+	placedRect = pl.rcNormalPosition;
 
 	// Don't activate window when resizing.
 	//SetWindowPos(hwnd, 0, wndrect.left, wndrect.top, wndrect.right - wndrect.left,
 	//	wndrect.bottom - wndrect.top, SWP_NOZORDER /* | SWP_NOACTIVATE */);
 }
 
+// Moves or resizes the gesture's window so that it follows the given point.
+static void TrackPointer(const POINT pt)
+{
+	if (inMoveState)
+		DragWindow(hwndref, pt);
+	else if (resizeState != NONE)
+		ResizeWindow(hwndref, pt);
+}
+
+static void CancelSettle(void)
+{
+	if (settleTimer) {
+		KillTimer(NULL, settleTimer);
+		settleTimer = 0;
+	}
+}
+
+static VOID CALLBACK SettleProc(HWND hwnd, UINT msg, UINT_PTR id, DWORD time)
+{
+	CancelSettle();
+	TrackPointer(settlePoint);
+}
+
+// Follows the pointer, leading it a little if motion prediction is on (and
+// we aren't shedding load).
+static void FollowPointer(const POINT pt)
+{
+	const POINT predicted = IsShedding() ? pt : PredictPoint(pt, GetPredictionTime());
+	TrackPointer(predicted);
+
+	if (firstMotionBegin) {
+		TraceEnd(isFirstMotionPrefetched ? TRACE_FIRSTMOTION_PREFETCHED : TRACE_FIRSTMOTION,
+			firstMotionBegin);
+		firstMotionBegin = 0;
+	}
+
+	if (predicted.x != pt.x || predicted.y != pt.y) {
+		settlePoint = pt;
+		settleTimer = SetTimer(NULL, settleTimer, SETTLE_DELAY_MS, SettleProc);
+	} else {
+		CancelSettle();
+	}
+}
+
+// Leaves the window exactly under the pointer at the end of a gesture, in
+// case prediction last put it somewhere else.
+static void FinishPointer(const POINT pt)
+{
+	if (settleTimer) {
+		CancelSettle();
+		TrackPointer(pt);
+	}
+}
+
+// Undo on ALT+Z, redo on ALT+SHIFT+Z. We swallow the key either way so the
+// application doesn't go looking for a Z mnemonic. An application that only
+// peeked at the keystroke (HC_NOREMOVE) will see it again as HC_ACTION, so
+// only that one counts.
+static int HandleUndoKey(const int code, const LPARAM lParam)
+{
+	const bool keyup = (lParam & 0x80000000) != 0;
+	const bool repeat = (lParam & 0x40000000) != 0;
+	if (code == HC_ACTION && !keyup && !repeat) {
+		if (GetKeyState(VK_SHIFT) < 0)
+			RedoGesture();
+		else
+			UndoGesture();
+		ClearPrefetch();
+
+		// Like a gesture, this keystroke mustn't leave ALT activating the menu bar.
+		quasimodeNeedsKeyUp = true;
+	}
+	return 1;
+}
+
 static LRESULT CALLBACK KbProc(const int code, const WPARAM wParam, const LPARAM lParam)
 {
 	int ret = 0;
-	if (code >= 0 && wParam == VK_MENU) {
-		int keyup = int(lParam & 0x80000000);
-		if (quasimodeNeedsKeyUp) {
+	if (code >= 0) {
+		HealthProbe probe;
+		TraceSpan span(TRACE_KBPROC);
+		if (wParam == VK_MENU) {
+			int keyup = int(lParam & 0x80000000);
+			int repeat = int(lParam & 0x40000000);
 			if (keyup) {
-				// Replace Alt SYSKEYUP with KEYUP message -- this prevents
-				// input focus from changing to the menu bar. TODO: Spy++
-				// tells us that apps don't actually receive this WM_KEYUP
-				// message. But everything still seems to be working ok.
-				PostMessage(NULL, WM_KEYUP, wParam, lParam);
-				quasimodeNeedsKeyUp = false;
-				ret = 1;
+				ClearPrefetch();
+				HideRevealPreview();
+			} else if (!repeat)
+				PrefetchTarget();
+			if (quasimodeNeedsKeyUp) {
+				if (keyup) {
+					// Replace Alt SYSKEYUP with KEYUP message -- this prevents
+					// input focus from changing to the menu bar. TODO: Spy++
+					// tells us that apps don't actually receive this WM_KEYUP
+					// message. But everything still seems to be working ok.
+					PostMessage(NULL, WM_KEYUP, wParam, lParam);
+					quasimodeNeedsKeyUp = false;
+					ret = 1;
+				}
 			}
+		} else if (wParam == UNDO_KEY && GetKeyState(QUASIMODE) < 0) {
+			ret = HandleUndoKey(code, lParam);
 		}
 	}
 
@@ -419,6 +983,7 @@ static LRESULT CALLBACK KbProc(const int code, const WPARAM wParam, const LPARAM
 // hierarchy for the first tangible window it can find.
 static HWND GetTangibleWindow(HWND hwnd, bool debug)
 {
+	TraceSpan span(TRACE_RESOLVE);
 	HWND prev = NULL;
 	HWND window = hwnd;
 
@@ -436,22 +1001,390 @@ static HWND GetTangibleWindow(HWND hwnd, bool debug)
 	return prev;
 }
 
+// Looks up everything a gesture on the tangible window hwnd needs to start.
+static void DescribeTarget(const HWND hwnd, TargetInfo *info)
+{
+	info->tangible = hwnd;
+	info->placement.length = sizeof(WINDOWPLACEMENT);
+	GetWindowPlacement(hwnd, &info->placement);
+	info->isFullScreen = IsFullScreen(hwnd);
+	info->isResizable = IsResizable(hwnd);
+}
+
+static void WritePrefetch(const Prefetch *p)
+{
+	InterlockedIncrement(&prefetchSeq);
+	prefetch = *p;
+	InterlockedIncrement(&prefetchSeq);
+}
+
+// ALT just went down, so a gesture is likely. Look up the window under the
+// cursor now rather than when the button goes down.
+static void PrefetchTarget(void)
+{
+	if (IsShedding())
+		return;
+	TraceSpan span(TRACE_PREFETCH);
+	Prefetch p;
+	ZeroMemory(&p, sizeof(p));
+	POINT pt;
+	if (GetCursorPos(&pt))
+		p.target = WindowFromPoint(pt);
+	if (p.target) {
+		p.time = GetTickCount();
+		DescribeTarget(GetTangibleWindow(p.target, false), &p.info);
+		GetWindowRect(p.info.tangible, &p.rect);
+	}
+	WritePrefetch(&p);
+}
+
+// Also called whenever we place a window ourselves while ALT may still be
+// down (undo/redo, fill, flick), since the prefetch may be for that window.
+static void ClearPrefetch(void)
+{
+	if (prefetch.target) {
+		Prefetch p;
+		ZeroMemory(&p, sizeof(p));
+		WritePrefetch(&p);
+	}
+}
+
+// Hands over the prefetched information if it's for the window the button
+// went down on and is still fresh: recent, and the window hasn't moved or
+// changed size since, which would make the placement we read stale. Either
+// way, it's only good for one gesture.
+static bool TakePrefetch(const HWND target, TargetInfo *info)
+{
+	const LONG seq = prefetchSeq;
+	if ((seq & 1) || !target || prefetch.target != target)
+		return false;
+	const Prefetch p = prefetch;
+	MemoryBarrier();
+	if (prefetchSeq != seq)
+		return false;
+
+	ClearPrefetch();
+	if (GetTickCount() - p.time > PREFETCH_MAX_AGE_MS || !IsWindow(p.info.tangible))
+		return false;
+	RECT r;
+	if (!GetWindowRect(p.info.tangible, &r) || !EqualRect(&r, &p.rect))
+		return false;
+	*info = p.info;
+	return true;
+}
+
+// Starts tracing the time from this button-down to the window's first move.
+static void BeginFirstMotion(const LONGLONG begin, const bool isPrefetched)
+{
+	firstMotionBegin = begin;
+	isFirstMotionPrefetched = isPrefetched;
+}
+
+// Returns true if this ALT+click on hwnd completes a double-click.
+static bool IsDoubleClick(const HWND hwnd, const POINT pt)
+{
+	const DWORD now = GetTickCount();
+	const bool isDouble = (hwnd == lastClickWindow) &&
+		(now - lastClickTime <= GetDoubleClickTime()) &&
+		(abs(pt.x - lastClickPoint.x) <= GetSystemMetrics(SM_CXDOUBLECLK) / 2) &&
+		(abs(pt.y - lastClickPoint.y) <= GetSystemMetrics(SM_CYDOUBLECLK) / 2);
+
+	// A triple-click isn't two double-clicks.
+	lastClickWindow = isDouble ? NULL : hwnd;
+	lastClickTime = now;
+	lastClickPoint = pt;
+	return isDouble;
+}
+
+// Grow a window to the largest empty rectangle around pt on its monitor.
+// Maximized windows and windows covering the whole work area (the desktop,
+// for one) would leave no room at all, so they don't count as obstacles.
+// Neither do the window's own owned windows.
+static void FillFreeSpace(const HWND hwnd, const POINT pt)
+{
+	WINDOWPLACEMENT before;
+	before.length = sizeof(WINDOWPLACEMENT);
+	GetWindowPlacement(hwnd, &before);
+	if (before.showCmd == SW_MAXIMIZE || IsFullScreen(hwnd))
+		return;
+
+	MONITORINFO mi;
+	mi.cbSize = sizeof(MONITORINFO);
+	if (!GetMonitorInfo(MonitorFromPoint(pt, MONITOR_DEFAULTTONEAREST), &mi))
+		return;
+	const RECT work = mi.rcWork;
+
+	const WindowTable *table = GetWindowTable();
+	const HWND owner = GetOwnerWindow(hwnd);
+	int count = 0;
+	for (int i = 0; i < table->count; i++) {
+		const HWND other = table->hwnd[i];
+		RECT r;
+		r.left = table->left[i];
+		r.top = table->top[i];
+		r.right = table->right[i];
+		r.bottom = table->bottom[i];
+
+		const bool coversWork = r.left <= work.left && r.top <= work.top &&
+			r.right >= work.right && r.bottom >= work.bottom;
+		if (other == hwnd || coversWork || IsZoomed(other) || GetOwnerWindow(other) == owner)
+			continue;
+		freeSpaceObstacles[count++] = r;
+	}
+
+	RECT r;
+	if (!FindFreeSpace(freeSpaceObstacles, count, &work, pt, &r))
+		return;
+
+	// The result is in screen coordinates, so this is a job for SetWindowPos()
+	// rather than SetWindowPlacement().
+	SetWindowPos(hwnd, NULL, r.left, r.top, r.right - r.left, r.bottom - r.top,
+		SWP_NOZORDER | SWP_NOACTIVATE);
+	ClearPrefetch();
+
+	WINDOWPLACEMENT after;
+	after.length = sizeof(WINDOWPLACEMENT);
+	if (GetWindowPlacement(hwnd, &after))
+		JournalPlacement(hwnd, &before, &after, 0);
+	NotifyGestureEnd(hwnd);
+}
+
+// Finds the monitor after the one hwnd is on, in enumeration order.
+struct NextMonitorSearch {
+	HMONITOR current;
+	HMONITOR first;
+	HMONITOR next;
+	bool isPastCurrent;
+};
+
+static BOOL CALLBACK NextMonitorProc(HMONITOR monitor, HDC hdc, LPRECT rect, LPARAM lParam)
+{
+	NextMonitorSearch *search = (NextMonitorSearch *)lParam;
+	if (!search->first)
+		search->first = monitor;
+	if (search->isPastCurrent) {
+		search->next = monitor;
+		return FALSE;
+	}
+	search->isPastCurrent = (monitor == search->current);
+	return TRUE;
+}
+
+// Works out where a window goes when it's sent from its monitor to the same
+// spot on the next one, shrunk if it doesn't fit there. r is the window's
+// rectangle in screen coordinates. Returns false if there's nowhere to go.
+static bool GetNextMonitorRect(const RECT *r, RECT *to)
+{
+	NextMonitorSearch search;
+	ZeroMemory(&search, sizeof(search));
+	search.current = MonitorFromRect(r, MONITOR_DEFAULTTONEAREST);
+	EnumDisplayMonitors(NULL, NULL, NextMonitorProc, (LPARAM)&search);
+	const HMONITOR next = search.next ? search.next : search.first;
+	if (!next || next == search.current)
+		return false;
+
+	MONITORINFO from, mi;
+	from.cbSize = mi.cbSize = sizeof(MONITORINFO);
+	if (!GetMonitorInfo(search.current, &from) || !GetMonitorInfo(next, &mi))
+		return false;
+
+	const LONG w = min(r->right - r->left, mi.rcWork.right - mi.rcWork.left);
+	const LONG h = min(r->bottom - r->top, mi.rcWork.bottom - mi.rcWork.top);
+	LONG x = mi.rcWork.left + (r->left - from.rcWork.left);
+	LONG y = mi.rcWork.top + (r->top - from.rcWork.top);
+	x = max(mi.rcWork.left, min(x, mi.rcWork.right - w));
+	y = max(mi.rcWork.top, min(y, mi.rcWork.bottom - h));
+	SetRect(to, x, y, x + w, y + h);
+	return true;
+}
+
+// Carries out a flick at the end of a move. Throws always start from where the
+// move found the window, so owned windows go back there, and so does the
+// window's restored position when it's maximized. Returns false if the flick
+// doesn't make sense for this window; it then stays where it was dragged,
+// along with its owned windows.
+static bool ThrowWindow(const HWND hwnd, const FlickDirection direction, const POINT pt)
+{
+	MONITORINFO mi;
+	mi.cbSize = sizeof(MONITORINFO);
+	if (!GetMonitorInfo(MonitorFromPoint(pt, MONITOR_DEFAULTTONEAREST), &mi))
+		return false;
+	const RECT work = mi.rcWork;
+	const LONG style = GetWindowLong(hwnd, GWL_STYLE);
+
+	// Where the window was in screen coordinates when the move started.
+	RECT r = startRect;
+	if (IsRectEmpty(&r))
+		return false;
+
+	// Settle where the window goes, and whether it can go there at all, before
+	// anything moves.
+	const LONG half = (work.right - work.left) / 2;
+	UINT flags = SWP_NOZORDER | SWP_NOACTIVATE;
+	RECT target;
+	switch (direction) {
+	case FLICK_LEFT:
+		if (!IsResizable(hwnd))
+			return false;
+		SetRect(&target, work.left, work.top, work.left + half, work.bottom);
+		break;
+	case FLICK_RIGHT:
+		if (!IsResizable(hwnd))
+			return false;
+		SetRect(&target, work.right - half, work.top, work.right, work.bottom);
+		break;
+	case FLICK_UP:
+		if (!(style & WS_MAXIMIZEBOX))
+			return false;
+		break;
+	case FLICK_DOWN:
+		if (!GetNextMonitorRect(&r, &target))
+			return false;
+		if (!IsResizable(hwnd))
+			flags |= SWP_NOSIZE;
+		break;
+	default:
+		return false;
+	}
+
+	if (groupSize > 0) {
+		const POINT unmoved = { 0, 0 };
+		DragGroup(unmoved);
+	}
+
+	bool isThrown;
+	if (direction == FLICK_UP) {
+		WINDOWPLACEMENT pl = placementref;
+		pl.showCmd = SW_SHOWMAXIMIZED;
+		pl.flags = 0;
+		isThrown = SetWindowPlacement(hwnd, &pl) != FALSE;
+	} else {
+		isThrown = SetWindowPos(hwnd, NULL, target.left, target.top,
+			target.right - target.left, target.bottom - target.top, flags) != FALSE;
+	}
+
+	// The window refused to go. Its owned windows go back to where they were
+	// dragged, next to it.
+	if (!isThrown && groupSize > 0) {
+		const POINT dragged = {
+			placedRect.left - placementref.rcNormalPosition.left,
+			placedRect.top - placementref.rcNormalPosition.top
+		};
+		DragGroup(dragged);
+	}
+	return isThrown;
+}
+
+// Records a move or resize of hwndref that ended where the hooks last put it.
+static void JournalDrag(const LONG gesture)
+{
+	WINDOWPLACEMENT after = placementref;
+	after.rcNormalPosition = placedRect;
+	JournalPlacement(hwndref, &placementref, &after, gesture);
+}
+
+// Records where the owned windows that came along with a move ended up, as
+// part of the same gesture as their owner.
+static void JournalGroup(const LONG gesture)
+{
+	for (int i = 0; i < groupSize; i++) {
+		WINDOWPLACEMENT pl;
+		pl.length = sizeof(WINDOWPLACEMENT);
+		if (GetWindowPlacement(groupWindows[i], &pl))
+			JournalPlacement(groupWindows[i], &groupPlacements[i], &pl, gesture);
+	}
+}
+
+// Ends a move, throwing the window if the move was a flick.
+static void FinishMove(const POINT pt)
+{
+	const LONG gesture = (groupSize > 0) ? NewJournalGesture() : 0;
+	const FlickDirection direction = EndFlick(pt);
+	if (direction == FLICK_NONE || IsShedding() || !ThrowWindow(hwndref, direction, pt)) {
+		FinishPointer(pt);
+		JournalDrag(gesture);
+		JournalGroup(gesture);
+		return;
+	}
+
+	CancelSettle();
+	ClearPrefetch();
+	WINDOWPLACEMENT after;
+	after.length = sizeof(WINDOWPLACEMENT);
+	if (GetWindowPlacement(hwndref, &after)) {
+		JournalPlacement(hwndref, &placementref, &after, gesture);
+		placedRect = after.rcNormalPosition;
+	}
+	JournalGroup(gesture);
+}
+
+// Tells plugins that a gesture let go of hwndref.
+static void EndPluginGesture(const GrappleGestureKind gesture, const POINT pt)
+{
+	RECT r = placedRect;
+	SendPluginEvent(GRAPPLE_EVENT_END, gesture, hwndref, pt, &r);
+}
+
+// Find the front-most window under a point ourselves, for the odd mouse
+// message that doesn't say which window it's for.
+static HWND GetWindowAtPoint(const POINT pt)
+{
+	TraceSpan span(TRACE_RESOLVE);
+	const WindowTable *table = GetWindowTable();
+	const int i = HitTestWindowTable(table, pt);
+	return (i >= 0) ? table->hwnd[i] : NULL;
+}
+
 // Global mouse hook procedure.
 static LRESULT WINAPI CALLBACK MouseProc(const int nCode, const WPARAM wParam, const LPARAM lParam)
 {
 	int ret = 0;
 
 	if (nCode >= 0) {
+		HealthProbe probe;
+		TraceSpan span(TRACE_MOUSEPROC);
 		const MOUSEHOOKSTRUCT *mouseHookStruct = (MOUSEHOOKSTRUCT *)lParam;
-		const HWND hwnd = GetTangibleWindow(mouseHookStruct->hwnd, false);
-		WINDOWPLACEMENT placement;
-		placement.length = sizeof(WINDOWPLACEMENT);
-		
+		HWND target = mouseHookStruct->hwnd;
+		if (!target && GetKeyState(QUASIMODE) < 0)
+			target = GetWindowAtPoint(mouseHookStruct->pt);
+
+		// Move and resize can usually start from what KbProc already found.
+		TargetInfo info;
+		const bool isGestureStart = wParam == WM_LBUTTONDOWN || wParam == WM_NCLBUTTONDOWN ||
+			wParam == WM_RBUTTONDOWN || wParam == WM_NCRBUTTONDOWN;
+		const bool isPrefetched = isGestureStart && GetKeyState(QUASIMODE) < 0 &&
+			TakePrefetch(target, &info);
+		const HWND hwnd = isPrefetched ? info.tangible : GetTangibleWindow(target, false);
+
+		// Plugins are loaded from the first mouse input that isn't part of a
+		// gesture, so no drag ever waits for them.
+		if (!isGestureStart && !inMoveState && resizeState == NONE && !inSendBackState)
+			LoadPlugins();
+
+		// Something else took mouse capture away mid send-to-back, so the
+		// button-up won't come to us.
+		if (inSendBackState && GetWindowThreadProcessId(sendBackCapture, NULL) == GetCurrentThreadId() &&
+				GetCapture() != sendBackCapture)
+			EndSendBack();
+
 		switch (wParam) {
 		case WM_NCMBUTTONDOWN:
 		case WM_MBUTTONDOWN:
-			if (GetKeyState(QUASIMODE) < 0 && !IsFullScreen(hwnd)) {
+			if (GetKeyState(QUASIMODE) < 0 && !inSendBackState && !IsFullScreen(hwnd)) {
 				inSendBackState = true;
+
+				// Hold on to the window, and to the mouse, so the button-up comes
+				// back to us and acts on this window whatever it's over by then.
+				// Refer to the comment in WM_LBUTTONDOWN for why we capture for
+				// mouseHookStruct->hwnd.
+				sendBackWindow = hwnd;
+				sendBackCapture = mouseHookStruct->hwnd;
+				SetCapture(sendBackCapture);
+
+				RECT outline;
+				revealTarget = ChooseRevealedWindow(hwnd, &outline);
+				if (revealTarget)
+					ShowRevealPreview(&outline);
 				ret = 1;
 			}
 			break;
@@ -459,21 +1392,42 @@ static LRESULT WINAPI CALLBACK MouseProc(const int nCode, const WPARAM wParam, c
 		case WM_NCMBUTTONUP:
 		case WM_MBUTTONUP:
 			if (inSendBackState) {
-				if (!IsFullScreen(hwnd))
-					EnumWindows(EnumWindowsProc, (LPARAM)hwnd);
-
-				inSendBackState = false;
+				const HWND back = sendBackWindow;
+				const HWND next = revealTarget;
+				ReleaseCapture();
+				EndSendBack();
+				if (IsWindow(back) && !IsFullScreen(back)) {
+					if (next && next != back && IsWindow(next)) {
+						ReplaceOnTop(back, next);
+					} else if (!SendToBackByMru(back)) {
+						TraceSpan enumSpan(TRACE_ENUMERATE);
+						EnumWindows(EnumWindowsProc, (LPARAM)back);
+					}
+				}
 				ret = 1;
 			}
 			break;
 
+		case WM_NCLBUTTONDBLCLK:
+		case WM_LBUTTONDBLCLK:
 		case WM_NCLBUTTONDOWN:
 		case WM_LBUTTONDOWN:
+			// Fill free space on double-click.
+			if (GetKeyState(QUASIMODE) < 0 && !inMoveState && resizeState == NONE &&
+					IsDoubleClick(hwnd, mouseHookStruct->pt)) {
+				FillFreeSpace(hwnd, mouseHookStruct->pt);
+				quasimodeNeedsKeyUp = true;
+				swallowLButtonUp = true;
+				ret = 1;
+				break;
+			}
+
 			// Drag anywhere.
-			GetWindowPlacement(hwnd, &placement);
+			if (!isPrefetched)
+				DescribeTarget(hwnd, &info);
 			
-			if (GetKeyState(QUASIMODE) < 0 && placement.showCmd != SW_MAXIMIZE &&
-					!inMoveState && resizeState == NONE && !IsFullScreen(hwnd)) {
+			if (GetKeyState(QUASIMODE) < 0 && info.placement.showCmd != SW_MAXIMIZE &&
+					!inMoveState && resizeState == NONE && !info.isFullScreen) {
 				BringWindowToTop(hwnd);
 				inMoveState = true;
 				quasimodeNeedsKeyUp = true;
@@ -489,10 +1443,17 @@ static LRESULT WINAPI CALLBACK MouseProc(const int nCode, const WPARAM wParam, c
 				SetCapture(mouseHookStruct->hwnd);
 
 				// Record starting window and mouse positions.
-				wndref.x = placement.rcNormalPosition.left;
-				wndref.y = placement.rcNormalPosition.top;
+				wndref.x = info.placement.rcNormalPosition.left;
+				wndref.y = info.placement.rcNormalPosition.top;
 				mouseref = mouseHookStruct->pt;
-				hwndref = hwnd;
+				BeginPlacement(hwnd, &info.placement);
+				isResizableRef = info.isResizable;
+				BeginGroup(hwnd);
+				ResetPrediction(mouseHookStruct->pt, GetPredictionTime());
+				BeginFlick(mouseHookStruct->pt);
+				BeginFirstMotion(span.GetBegin(), isPrefetched);
+				SendPluginEvent(GRAPPLE_EVENT_BEGIN, GRAPPLE_GESTURE_MOVE,
+					hwnd, mouseHookStruct->pt, &info.placement.rcNormalPosition);
 
 				ret = 1;
 			}
@@ -501,12 +1462,13 @@ static LRESULT WINAPI CALLBACK MouseProc(const int nCode, const WPARAM wParam, c
 		case WM_NCRBUTTONDOWN:
 		case WM_RBUTTONDOWN:
 			// Resize anywhere.
-			GetWindowPlacement(hwnd, &placement);
-			if ((GetKeyState(QUASIMODE) < 0) && placement.showCmd != SW_MAXIMIZE &&
-					!inMoveState && resizeState == NONE && !IsFullScreen(hwnd)) {
+			if (!isPrefetched)
+				DescribeTarget(hwnd, &info);
+			if ((GetKeyState(QUASIMODE) < 0) && info.placement.showCmd != SW_MAXIMIZE &&
+					!inMoveState && resizeState == NONE && !info.isFullScreen) {
 				BringWindowToTop(hwnd);
 				quasimodeNeedsKeyUp = true;
-				const RECT r = placement.rcNormalPosition;
+				const RECT r = info.placement.rcNormalPosition;
 				const int xhalf = (r.left + r.right) / 2;
 				const int yhalf = (r.top + r.bottom) / 2;
 				POINT pt = mouseHookStruct->pt;
@@ -520,9 +1482,14 @@ static LRESULT WINAPI CALLBACK MouseProc(const int nCode, const WPARAM wParam, c
 				SetCapture(mouseHookStruct->hwnd);
 
 				// Record starting window and mouse positions.
-				wndrectref = placement.rcNormalPosition;
+				wndrectref = info.placement.rcNormalPosition;
 				mouseref = mouseHookStruct->pt;
-				hwndref = hwnd;
+				BeginPlacement(hwnd, &info.placement);
+				isResizableRef = info.isResizable;
+				ResetPrediction(mouseHookStruct->pt, GetPredictionTime());
+				BeginFirstMotion(span.GetBegin(), isPrefetched);
+				SendPluginEvent(GRAPPLE_EVENT_BEGIN, GRAPPLE_GESTURE_RESIZE,
+					hwnd, mouseHookStruct->pt, &info.placement.rcNormalPosition);
 
 				ret = 1;
 			}
@@ -533,6 +1500,13 @@ static LRESULT WINAPI CALLBACK MouseProc(const int nCode, const WPARAM wParam, c
 			if (inMoveState) {
 				ReleaseCapture();
 				inMoveState = false;
+				FinishMove(mouseHookStruct->pt);
+				groupSize = 0;
+				EndPluginGesture(GRAPPLE_GESTURE_MOVE, mouseHookStruct->pt);
+				NotifyGestureEnd(hwndref);
+				ret = 1;
+			} else if (swallowLButtonUp) {
+				swallowLButtonUp = false;
 				ret = 1;
 			}
 			break;
@@ -540,19 +1514,22 @@ static LRESULT WINAPI CALLBACK MouseProc(const int nCode, const WPARAM wParam, c
 		case WM_NCRBUTTONUP:
 		case WM_RBUTTONUP:
 			if (resizeState != NONE) {
+				FinishPointer(mouseHookStruct->pt);
 				ReleaseCapture();
 				resizeState = NONE;
+				JournalDrag(0);
+				EndPluginGesture(GRAPPLE_GESTURE_RESIZE, mouseHookStruct->pt);
+				NotifyGestureEnd(hwndref);
 				ret = 1;
 			}
 			break;
 
 		case WM_NCMOUSEMOVE:
 		case WM_MOUSEMOVE:
-			if (inMoveState) {
-				DragWindow(hwndref, mouseHookStruct->pt);
-				ret = 1;
-			} else if (resizeState != NONE) {
-				ResizeWindow(hwndref, mouseHookStruct->pt);
+			if (inMoveState || resizeState != NONE) {
+				if (inMoveState)
+					TrackFlick(mouseHookStruct->pt);
+				FollowPointer(mouseHookStruct->pt);
 				ret = 1;
 			}
 			break;
@@ -25,6 +25,18 @@
 #define GRAPPLELIB_API __declspec(dllimport)
 #endif
 
+#include "HookHealth.h"
+
 // Don't forget to keep GrappleLib.def in sync with this list!
 GRAPPLELIB_API bool WINAPI InstallHook(void);
 GRAPPLELIB_API void WINAPI RemoveHook(void);
+GRAPPLELIB_API bool WINAPI EnableTrace(bool enable);
+GRAPPLELIB_API bool WINAPI SaveTrace(const TCHAR *path);
+GRAPPLELIB_API void WINAPI SetPrediction(bool enable, int leadMs);
+GRAPPLELIB_API void WINAPI GetHookHealth(HookHealth *health);
+GRAPPLELIB_API void WINAPI SetHookBudget(LONG budgetUs, bool shed);
+GRAPPLELIB_API void WINAPI SetNotifyWindow(HWND hwnd, UINT msg);
+GRAPPLELIB_API void WINAPI SetRevealPreview(HWND hwnd, UINT msg);
+GRAPPLELIB_API bool WINAPI ReinstallHook(void);
+GRAPPLELIB_API bool WINAPI SetGeometryRestore(bool enable);
+GRAPPLELIB_API void WINAPI InvalidateTables(void);
@@ -0,0 +1,99 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** GrapplePlugin.h
+** Interface for Grapple plugins. Plugin DLLs include this header.
+**
+** Plugins live in a "Plugins" folder next to GrappleLib.dll and must match its
+** bitness. Because our hooks run inside every process on the desktop, so do
+** plugins: each hooked process loads them the first time it sees mouse input
+** outside a gesture. A plugin exports GrapplePluginInit (by name, with C
+** linkage, and undecorated; on x86 that takes a .def file), which fills in
+** its callbacks and returns TRUE to be loaded.
+**
+** Every gesture is broadcast as a series of events written once into a ring
+** owned by Grapple. Callbacks get a pointer straight into that ring, and the
+** ring itself is handed over at init, so a plugin that wants recent history
+** can read it back without anything being copied. Events and the ring are
+** read-only to plugins, and only valid on the thread that delivered them.
+**
+** Callbacks run on the thread of the application whose window is being
+** dragged, in the middle of the drag, so they must be quick. Each one is
+** timed; a plugin that goes over GRAPPLE_PLUGIN_BUDGET_US is skipped for the
+** rest of the gesture, and after a few of those it's skipped for good.
+** GrapplePluginInit is held to the same budget; a plugin whose init goes
+** over is never called at all.
+**
+** A minimal plugin that keeps windows on a 16 pixel grid:
+**
+**   static void WINAPI Snap(const GrappleEvent *event, RECT *rect)
+**   {
+**       const LONG dx = (rect->left + 8) / 16 * 16 - rect->left;
+**       const LONG dy = (rect->top + 8) / 16 * 16 - rect->top;
+**       OffsetRect(rect, dx, dy);
+**   }
+**
+**   extern "C" BOOL WINAPI GrapplePluginInit(const GrappleEventRing *ring, GrapplePlugin *plugin)
+**   {
+**       plugin->AdjustRect = Snap;
+**       return TRUE;
+**   }
+**
+** It's built, along with a deliberately slow plugin for GrappleBench, by the
+** projects in SamplePlugins.
+*/
+
+#pragma once
+
+#define GRAPPLE_PLUGIN_VERSION 1
+#define GRAPPLE_PLUGIN_INIT "GrapplePluginInit"
+
+static const LONG GRAPPLE_PLUGIN_BUDGET_US = 2000;
+
+// Must be a power of two.
+static const LONG GRAPPLE_EVENT_RING_SIZE = 256;
+
+enum GrappleEventKind {
+	GRAPPLE_EVENT_BEGIN = 0,    // A gesture picked up hwnd.
+	GRAPPLE_EVENT_MOTION = 1,   // The pointer moved; rect is where hwnd is about to go.
+	GRAPPLE_EVENT_END = 2       // The gesture let go of hwnd; rect is where it was left.
+};
+
+enum GrappleGestureKind {
+	GRAPPLE_GESTURE_MOVE = 0,
+	GRAPPLE_GESTURE_RESIZE = 1
+};
+
+struct GrappleEvent {
+	LONG seq;                   // Counts up from zero in each process.
+	DWORD kind;                 // GrappleEventKind.
+	DWORD gesture;              // GrappleGestureKind.
+	HWND hwnd;
+	POINT pt;                   // Pointer, in screen coordinates.
+	RECT rect;                  // Window's normal position, in workspace coordinates.
+	LONGLONG time;              // QueryPerformanceCounter() timestamp.
+};
+
+struct GrappleEventRing {
+	volatile LONG next;         // seq of the next event to be written.
+	GrappleEvent events[GRAPPLE_EVENT_RING_SIZE];  // Event seq is at seq & (size - 1).
+};
+
+struct GrapplePlugin {
+	DWORD version;              // Set to GRAPPLE_PLUGIN_VERSION before init.
+
+	// Optional. Called for every event.
+	void (WINAPI *OnEvent)(const GrappleEvent *event);
+
+	// Optional. Called for MOTION events before the window is placed, with
+	// *rect starting out as event->rect (or as the previous plugin left it).
+	// Change *rect to put the window somewhere else. Owned windows that are
+	// dragged along with a move only follow the top-left corner.
+	void (WINAPI *AdjustRect)(const GrappleEvent *event, RECT *rect);
+};
+
+typedef BOOL (WINAPI *GrapplePluginInitFn)(const GrappleEventRing *ring, GrapplePlugin *plugin);
@@ -0,0 +1,84 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Health.cpp
+** Heartbeat and latency accounting for our hook procedures.
+**
+** Windows gives up on hooks that take too long, and it doesn't tell anybody
+** when it does. Every hook call bumps a shared heartbeat and checks its own
+** running time against a budget, so that Grapple.exe can notice when we're
+** getting slow (and shed work) or when the heartbeat stops (and reinstall).
+*/
+
+#include "stdafx.h"
+#include "Health.h"
+
+static const LONG DEFAULT_BUDGET_US = 10000;
+
+#pragma data_seg(".shared")
+static volatile LONG heartbeat = 0;
+static volatile LONG slowCalls = 0;
+static volatile LONG maxLatencyUs = 0;
+static volatile LONG totalLatencyUs = 0;
+static volatile LONG budgetUs = DEFAULT_BUDGET_US;
+static volatile LONG isShedding = 0;
+#pragma data_seg()
+
+static LONGLONG ticksPerSecond = 0;
+
+LONGLONG HealthBegin(void)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+void HealthEnd(LONGLONG begin)
+{
+	if (!ticksPerSecond) {
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		ticksPerSecond = frequency.QuadPart;
+	}
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	const LONG us = (LONG)((now.QuadPart - begin) * 1000000 / ticksPerSecond);
+
+	InterlockedIncrement(&heartbeat);
+	InterlockedExchangeAdd(&totalLatencyUs, us);
+	if (us > budgetUs)
+		InterlockedIncrement(&slowCalls);
+
+	// Raise the shared maximum, unless somebody beat us to a bigger one.
+	LONG seen = maxLatencyUs;
+	while (us > seen) {
+		const LONG prev = InterlockedCompareExchange(&maxLatencyUs, us, seen);
+		if (prev == seen)
+			break;
+		seen = prev;
+	}
+}
+
+void ReadHealth(HookHealth *health)
+{
+	health->heartbeat = heartbeat;
+	health->slowCalls = InterlockedExchange(&slowCalls, 0);
+	health->maxLatencyUs = InterlockedExchange(&maxLatencyUs, 0);
+	health->totalLatencyUs = InterlockedExchange(&totalLatencyUs, 0);
+}
+
+void SetHealthOptions(LONG budget, bool shed)
+{
+	if (budget > 0)
+		InterlockedExchange(&budgetUs, budget);
+	InterlockedExchange(&isShedding, shed ? 1 : 0);
+}
+
+bool IsShedding(void)
+{
+	return isShedding != 0;
+}
@@ -0,0 +1,40 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Health.h
+** Heartbeat and latency accounting for our hook procedures.
+*/
+
+#pragma once
+
+#include "HookHealth.h"
+
+LONGLONG HealthBegin(void);
+void HealthEnd(LONGLONG begin);
+
+// Copies out the current statistics and starts a new measurement window.
+void ReadHealth(HookHealth *health);
+
+// Sets the per-call latency budget, and whether hooks should skip optional
+// work (motion prediction, group dragging and the like) to stay inside it.
+void SetHealthOptions(LONG budgetUs, bool shed);
+
+// True while Grapple.exe wants optional work skipped.
+bool IsShedding(void);
+
+// Counts a hook call, and how long it took.
+class HealthProbe {
+public:
+	HealthProbe() : begin(HealthBegin()) {}
+	~HealthProbe() { HealthEnd(begin); }
+
+private:
+	const LONGLONG begin;
+
+	HealthProbe(const HealthProbe &);
+	HealthProbe &operator=(const HealthProbe &);
+};
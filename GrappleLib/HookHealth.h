@@ -0,0 +1,19 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** HookHealth.h
+** Hook health statistics shared between GrappleLib and Grapple.exe.
+*/
+
+#pragma once
+
+struct HookHealth {
+	LONG heartbeat;      // Hook calls so far, across all processes. Wraps.
+	LONG slowCalls;      // Calls over budget since the last GetHookHealth().
+	LONG maxLatencyUs;   // Slowest call since the last GetHookHealth().
+	LONG totalLatencyUs; // Time spent in calls since the last GetHookHealth().
+};
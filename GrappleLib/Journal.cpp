@@ -0,0 +1,222 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Journal.cpp
+** Undo/redo history of completed gestures.
+**
+** Gestures happen inside whichever process owns the window, while ALT+Z is
+** handled by whichever process has the keyboard, so the journal lives in
+** the shared data segment. It's a fixed ring of fixed-size entries: recording
+** a gesture is a copy into the ring, and undoing one never needs to look at
+** any window other than the one recorded.
+**
+** The lock is given up on after a few ms (see SharedLock.h). A gesture that
+** can't get it isn't recorded, and an ALT+Z that can't get it does nothing.
+*/
+
+#include "stdafx.h"
+#include "Journal.h"
+#include "WindowTable.h"
+#include "SharedLock.h"
+
+// Must be a power of two.
+static const LONG JOURNAL_SIZE = 64;
+
+enum JournalKind { JOURNAL_PLACEMENT, JOURNAL_SENDTOBACK };
+
+struct JournalEntry {
+	HWND hwnd;
+	LONG kind;
+	LONG gesture;
+	RECT before;         // Normal positions, in workspace coordinates.
+	RECT after;
+	UINT showBefore;     // Show states, so maximizing can be undone too.
+	UINT showAfter;
+	HWND above;
+	LONG wasTopmost;
+};
+
+#pragma data_seg(".shared")
+static volatile LONG journalLock = 0;
+static LONG journalTail = 0;    // The oldest entry that hasn't been overwritten.
+static LONG journalHead = 0;    // One past the newest entry.
+static LONG journalCursor = 0;  // Entries before the cursor are done, after it undone.
+static volatile LONG lastGesture = 0;
+static JournalEntry journal[JOURNAL_SIZE] = { 0 };
+#pragma data_seg()
+
+// Returns false if the journal stayed busy. If its last holder went away,
+// the journal is emptied, since that holder may have left it half-written.
+static bool LockJournal(void)
+{
+	switch (TakeSharedLock(&journalLock)) {
+	case SHARED_LOCK_ABANDONED:
+		journalTail = journalHead = journalCursor = 0;
+		return true;
+	case SHARED_LOCK_TAKEN:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void UnlockJournal(void)
+{
+	ReleaseSharedLock(&journalLock);
+}
+
+// Never returns zero, even when the count wraps.
+static LONG NextGesture(void)
+{
+	LONG gesture = InterlockedIncrement(&lastGesture);
+	if (!gesture)
+		gesture = InterlockedIncrement(&lastGesture);
+	return gesture;
+}
+
+LONG NewJournalGesture(void)
+{
+	return NextGesture();
+}
+
+static void Record(JournalEntry *entry)
+{
+	if (!LockJournal())
+		return;
+	if (!entry->gesture)
+		entry->gesture = NextGesture();
+
+	// Recording after an undo throws away whatever could have been redone.
+	// The head moves back when that happens, and the slots it gives up still
+	// hold the thrown-away entries, so the oldest usable entry can't be worked
+	// out from the head. The tail only ever moves forward instead.
+	journal[journalCursor & (JOURNAL_SIZE - 1)] = *entry;
+	journalCursor++;
+	journalHead = journalCursor;
+	if (journalTail < journalCursor - JOURNAL_SIZE)
+		journalTail = journalCursor - JOURNAL_SIZE;
+
+	UnlockJournal();
+}
+
+void JournalPlacement(HWND hwnd, const WINDOWPLACEMENT *before,
+	const WINDOWPLACEMENT *after, LONG gesture)
+{
+	// A maximize leaves the normal position alone, so that alone doesn't
+	// mean nothing happened.
+	if (EqualRect(&before->rcNormalPosition, &after->rcNormalPosition) &&
+			before->showCmd == after->showCmd)
+		return;
+
+	JournalEntry entry;
+	entry.hwnd = hwnd;
+	entry.kind = JOURNAL_PLACEMENT;
+	entry.gesture = gesture;
+	entry.before = before->rcNormalPosition;
+	entry.after = after->rcNormalPosition;
+	entry.showBefore = before->showCmd;
+	entry.showAfter = after->showCmd;
+	entry.above = NULL;
+	entry.wasTopmost = 0;
+	Record(&entry);
+}
+
+void JournalSendToBack(HWND hwnd, HWND above, bool wasTopmost)
+{
+	JournalEntry entry;
+	ZeroMemory(&entry, sizeof(entry));
+	entry.hwnd = hwnd;
+	entry.kind = JOURNAL_SENDTOBACK;
+	entry.above = above;
+	entry.wasTopmost = wasTopmost ? 1 : 0;
+	Record(&entry);
+}
+
+static void ApplyPlacement(HWND hwnd, const RECT *r, UINT showCmd)
+{
+	WINDOWPLACEMENT pl;
+	pl.length = sizeof(WINDOWPLACEMENT);
+	if (GetWindowPlacement(hwnd, &pl)) {
+		pl.rcNormalPosition = *r;
+		pl.showCmd = showCmd;
+		SetWindowPlacement(hwnd, &pl);
+	}
+}
+
+static void Apply(const JournalEntry *entry, bool undo)
+{
+	if (!IsWindow(entry->hwnd))
+		return;
+
+	const UINT flags = SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE;
+	switch (entry->kind) {
+	case JOURNAL_PLACEMENT:
+		if (undo)
+			ApplyPlacement(entry->hwnd, &entry->before, entry->showBefore);
+		else
+			ApplyPlacement(entry->hwnd, &entry->after, entry->showAfter);
+		break;
+
+	case JOURNAL_SENDTOBACK:
+		if (!undo) {
+			SetWindowPos(entry->hwnd, HWND_BOTTOM, 0, 0, 0, 0, flags);
+		} else if (entry->wasTopmost) {
+			SetWindowPos(entry->hwnd, HWND_TOPMOST, 0, 0, 0, 0, flags);
+		} else if (entry->above && IsWindow(entry->above)) {
+			// Inserting after a window places us directly below it.
+			SetWindowPos(entry->hwnd, entry->above, 0, 0, 0, 0, flags);
+		} else {
+			SetWindowPos(entry->hwnd, HWND_TOP, 0, 0, 0, 0, flags);
+		}
+		InvalidateWindowTables();
+		break;
+
+	default:
+		break;
+	}
+}
+
+// Pops the newest done gesture (or the oldest undone one, when redoing) off
+// the journal into entries, in the order it should be applied. Returns how
+// many entries there were.
+static int TakeGesture(JournalEntry *entries, bool undo)
+{
+	if (!LockJournal())
+		return 0;
+	int count = 0;
+	LONG gesture = 0;
+	while (undo ? journalCursor > journalTail : journalCursor < journalHead) {
+		const LONG next = undo ? journalCursor - 1 : journalCursor;
+		const JournalEntry *entry = &journal[next & (JOURNAL_SIZE - 1)];
+		if (count > 0 && entry->gesture != gesture)
+			break;
+		gesture = entry->gesture;
+		entries[count++] = *entry;
+		journalCursor += undo ? -1 : 1;
+	}
+	UnlockJournal();
+	return count;
+}
+
+bool UndoGesture(void)
+{
+	// Don't hold the lock while other applications process our requests.
+	JournalEntry entries[JOURNAL_SIZE];
+	const int count = TakeGesture(entries, true);
+	for (int i = 0; i < count; i++)
+		Apply(&entries[i], true);
+	return count > 0;
+}
+
+bool RedoGesture(void)
+{
+	JournalEntry entries[JOURNAL_SIZE];
+	const int count = TakeGesture(entries, false);
+	for (int i = 0; i < count; i++)
+		Apply(&entries[i], false);
+	return count > 0;
+}
@@ -0,0 +1,32 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Journal.h
+** Undo/redo history of completed gestures.
+*/
+
+#pragma once
+
+// Returns a new gesture id. Everything recorded under the same id is undone
+// and redone as one step, for gestures that move several windows at once.
+LONG NewJournalGesture(void);
+
+// Records a finished move, resize or maximize: the window's normal (restored)
+// position and its show state before and after. A gesture of zero records
+// this as a gesture of its own.
+void JournalPlacement(HWND hwnd, const WINDOWPLACEMENT *before,
+	const WINDOWPLACEMENT *after, LONG gesture);
+
+// Records a send-to-back. `above` is the window that was directly above hwnd
+// in the z-order beforehand, or NULL if hwnd was at the top.
+void JournalSendToBack(HWND hwnd, HWND above, bool wasTopmost);
+
+// Undoes the most recent gesture, or redoes the last one undone, including
+// every window it moved. Returns
+// false when there's nothing left to undo/redo, or the journal was busy.
+bool UndoGesture(void);
+bool RedoGesture(void);
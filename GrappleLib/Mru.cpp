@@ -0,0 +1,215 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Mru.cpp
+** Most-recently-activated list of top-level windows.
+**
+** Send-to-back used to guess which window to activate next from the z-order,
+** which isn't always the window the user was working in before. Instead we
+** keep a most-recently-activated list like the one ALT+TAB uses, updated as
+** the foreground changes rather than rebuilt when it's needed. It's a doubly
+** linked list over a fixed node array in the shared data segment, since it's
+** written by Grapple.exe and read by whichever process gets the middle click.
+** Once the list is full, the least recently activated window drops off.
+** If the lock stays busy for more than a few ms (see SharedLock.h), updates
+** are dropped and readers get an empty list.
+*/
+
+#include "stdafx.h"
+#include "Mru.h"
+#include "SharedLock.h"
+
+struct MruNode {
+	HWND hwnd;
+	LONG prev;
+	LONG next;
+};
+
+#pragma data_seg(".shared")
+static volatile LONG mruLock = 0;
+static LONG mruHead = -1;       // Most recently activated.
+static LONG mruTail = -1;       // Least recently activated.
+static LONG mruFree = -1;       // Nodes given back by destroyed windows.
+static LONG mruUsed = 0;        // Nodes handed out so far, from the front.
+static MruNode mruNodes[MRU_SIZE] = { { NULL, -1, -1 } };
+#pragma data_seg()
+
+// Only used in Grapple.exe.
+static HWINEVENTHOOK foregroundHook = NULL;
+static HWINEVENTHOOK destroyHook = NULL;
+
+// Empties the list. Call with the lock held.
+static void ClearMru(void)
+{
+	mruHead = -1;
+	mruTail = -1;
+	mruFree = -1;
+	mruUsed = 0;
+}
+
+// Returns false if the list stayed busy. If its last holder went away, the
+// list is emptied, since that holder may have left it half-linked.
+static bool LockMru(void)
+{
+	switch (TakeSharedLock(&mruLock)) {
+	case SHARED_LOCK_ABANDONED:
+		ClearMru();
+		return true;
+	case SHARED_LOCK_TAKEN:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void UnlockMru(void)
+{
+	ReleaseSharedLock(&mruLock);
+}
+
+static LONG FindNode(HWND hwnd)
+{
+	for (LONG i = mruHead; i >= 0; i = mruNodes[i].next) {
+		if (mruNodes[i].hwnd == hwnd)
+			return i;
+	}
+	return -1;
+}
+
+static void Unlink(LONG i)
+{
+	MruNode *node = &mruNodes[i];
+	if (node->prev >= 0)
+		mruNodes[node->prev].next = node->next;
+	else
+		mruHead = node->next;
+	if (node->next >= 0)
+		mruNodes[node->next].prev = node->prev;
+	else
+		mruTail = node->prev;
+	node->prev = node->next = -1;
+}
+
+static void PushFront(LONG i)
+{
+	MruNode *node = &mruNodes[i];
+	node->prev = -1;
+	node->next = mruHead;
+	if (mruHead >= 0)
+		mruNodes[mruHead].prev = i;
+	mruHead = i;
+	if (mruTail < 0)
+		mruTail = i;
+}
+
+// A free node: a fresh one, a recycled one, or failing that the least
+// recently activated one.
+static LONG AllocateNode(void)
+{
+	if (mruUsed < MRU_SIZE)
+		return mruUsed++;
+	if (mruFree >= 0) {
+		const LONG i = mruFree;
+		mruFree = mruNodes[i].next;
+		return i;
+	}
+	const LONG i = mruTail;
+	Unlink(i);
+	return i;
+}
+
+static void Activated(HWND hwnd)
+{
+	if (!LockMru())
+		return;
+	LONG i = FindNode(hwnd);
+	if (i >= 0) {
+		if (i != mruHead) {
+			Unlink(i);
+			PushFront(i);
+		}
+	} else {
+		i = AllocateNode();
+		mruNodes[i].hwnd = hwnd;
+		PushFront(i);
+	}
+	UnlockMru();
+}
+
+// By the time we hear about it the window is gone, so we can't tell whether
+// it was top-level. Only windows on the list matter anyway.
+static void Destroyed(HWND hwnd)
+{
+	if (!LockMru())
+		return;
+	const LONG i = FindNode(hwnd);
+	if (i >= 0) {
+		Unlink(i);
+		mruNodes[i].hwnd = NULL;
+		mruNodes[i].next = mruFree;
+		mruFree = i;
+	}
+	UnlockMru();
+}
+
+static void CALLBACK MruEventProc(HWINEVENTHOOK hook, DWORD event, HWND hwnd,
+	LONG idObject, LONG idChild, DWORD thread, DWORD time)
+{
+	if (idObject != OBJID_WINDOW || idChild != CHILDID_SELF || !hwnd)
+		return;
+	if (event == EVENT_SYSTEM_FOREGROUND)
+		Activated(hwnd);
+	else if (event == EVENT_OBJECT_DESTROY)
+		Destroyed(hwnd);
+}
+
+bool StartMru(void)
+{
+	if (!foregroundHook) {
+		foregroundHook = SetWinEventHook(EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND,
+			NULL, MruEventProc, 0, 0, WINEVENT_OUTOFCONTEXT);
+		const HWND foreground = GetForegroundWindow();
+		if (foreground)
+			Activated(foreground);
+	}
+	if (!destroyHook) {
+		destroyHook = SetWinEventHook(EVENT_OBJECT_DESTROY, EVENT_OBJECT_DESTROY,
+			NULL, MruEventProc, 0, 0, WINEVENT_OUTOFCONTEXT);
+	}
+	return foregroundHook && destroyHook;
+}
+
+void StopMru(void)
+{
+	if (foregroundHook) {
+		UnhookWinEvent(foregroundHook);
+		foregroundHook = NULL;
+	}
+	if (destroyHook) {
+		UnhookWinEvent(destroyHook);
+		destroyHook = NULL;
+	}
+
+	// Nobody's keeping the list up to date any more, and whatever is on it
+	// will be stale by the time we start again. Hooked processes may still
+	// be reading it, so this goes through the lock too.
+	if (LockMru()) {
+		ClearMru();
+		UnlockMru();
+	}
+}
+
+int GetMruWindows(HWND *windows, int max)
+{
+	int count = 0;
+	if (!LockMru())
+		return 0;
+	for (LONG i = mruHead; i >= 0 && count < max; i = mruNodes[i].next)
+		windows[count++] = mruNodes[i].hwnd;
+	UnlockMru();
+	return count;
+}
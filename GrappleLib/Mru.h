@@ -0,0 +1,24 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Mru.h
+** Most-recently-activated list of top-level windows.
+*/
+
+#pragma once
+
+static const int MRU_SIZE = 64;
+
+// Starts or stops following foreground changes. These install out-of-context
+// WinEvent hooks, so only Grapple.exe (which has a message loop) calls them.
+bool StartMru(void);
+void StopMru(void);
+
+// Copies out up to max windows, most recently activated first. Returns how
+// many were copied, which is none if the list was busy. Windows may have
+// been destroyed since.
+int GetMruWindows(HWND *windows, int max);
@@ -0,0 +1,166 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Plugins.cpp
+** Loads plugins and broadcasts gesture events to them.
+**
+** Everything here is per process and preallocated: the plugin table, and the
+** ring that events are written into once and read from by every plugin. We
+** can't interrupt a plugin that's taking too long, but we can notice after
+** the fact and stop calling it, so one slow plugin costs at most a few
+** stutters instead of every drag from then on. Loading happens outside
+** gestures, since finding and starting plugins takes far longer than any
+** drag can wait.
+**
+** Plugins are never unloaded. FreeLibrary() isn't safe from DllMain(), and a
+** plugin left behind when our hooks are removed is never called again.
+*/
+
+#include "stdafx.h"
+#include "Plugins.h"
+#include "Health.h"
+
+static const int MAX_PLUGINS = 8;
+
+// Plugins that go over budget this many times aren't called again.
+static const int MAX_OVERRUNS = 3;
+
+struct LoadedPlugin {
+	GrapplePlugin api;
+	int overruns;
+	LONG skippedGesture;         // Skipped for the rest of this gesture.
+	bool isDisabled;
+};
+
+static GrappleEventRing ring;
+static LoadedPlugin plugins[MAX_PLUGINS];
+static int pluginCount = 0;
+static bool hasLoaded = false;
+static LONGLONG budgetTicks = 0;
+static LONG gestureCount = 0;
+
+bool LoadPlugin(const TCHAR *path)
+{
+	if (pluginCount >= MAX_PLUGINS)
+		return false;
+	if (!budgetTicks) {
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		budgetTicks = frequency.QuadPart * GRAPPLE_PLUGIN_BUDGET_US / 1000000;
+	}
+
+	HMODULE module = LoadLibrary(path);
+	if (!module)
+		return false;
+	GrapplePluginInitFn init = (GrapplePluginInitFn)GetProcAddress(module, GRAPPLE_PLUGIN_INIT);
+	LoadedPlugin *plugin = &plugins[pluginCount];
+	ZeroMemory(plugin, sizeof(LoadedPlugin));
+	plugin->api.version = GRAPPLE_PLUGIN_VERSION;
+	LARGE_INTEGER begin, end;
+	QueryPerformanceCounter(&begin);
+	if (!init || !init(&ring, &plugin->api) || (!plugin->api.OnEvent && !plugin->api.AdjustRect)) {
+		FreeLibrary(module);
+		return false;
+	}
+	QueryPerformanceCounter(&end);
+
+	// Init is held to the same budget as the callbacks. A plugin that goes
+	// over is never called, but it stays loaded, because it may have
+	// started something that still needs its code.
+	if (end.QuadPart - begin.QuadPart > budgetTicks)
+		return false;
+	pluginCount++;
+	return true;
+}
+
+void LoadPlugins(void)
+{
+	if (hasLoaded)
+		return;
+	hasLoaded = true;
+
+	HMODULE self;
+	if (!GetModuleHandleEx(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+			GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCTSTR)&ring, &self))
+		return;
+	TCHAR dir[MAX_PATH];
+	const DWORD length = GetModuleFileName(self, dir, MAX_PATH);
+	if (!length || length >= MAX_PATH)
+		return;
+	TCHAR *slash = _tcsrchr(dir, TEXT('\\'));
+	if (!slash)
+		return;
+	*slash = 0;
+
+	TCHAR pattern[MAX_PATH];
+	if (_sntprintf_s(pattern, MAX_PATH, _TRUNCATE, TEXT("%s\\Plugins\\*.dll"), dir) < 0)
+		return;
+	WIN32_FIND_DATA found;
+	HANDLE find = FindFirstFile(pattern, &found);
+	if (find == INVALID_HANDLE_VALUE)
+		return;
+	do {
+		TCHAR path[MAX_PATH];
+		if (_sntprintf_s(path, MAX_PATH, _TRUNCATE, TEXT("%s\\Plugins\\%s"), dir, found.cFileName) >= 0)
+			LoadPlugin(path);
+	} while (pluginCount < MAX_PLUGINS && FindNextFile(find, &found));
+	FindClose(find);
+}
+
+static GrappleEvent *WriteEvent(GrappleEventKind kind, GrappleGestureKind gesture,
+	HWND hwnd, const POINT pt, const RECT *rect)
+{
+	const LONG seq = ring.next;
+	GrappleEvent *event = &ring.events[seq & (GRAPPLE_EVENT_RING_SIZE - 1)];
+	event->seq = seq;
+	event->kind = kind;
+	event->gesture = gesture;
+	event->hwnd = hwnd;
+	event->pt = pt;
+	event->rect = *rect;
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	event->time = now.QuadPart;
+	ring.next = seq + 1;
+	return event;
+}
+
+// Calls one plugin and holds it to its budget.
+static void Deliver(LoadedPlugin *plugin, const GrappleEvent *event, RECT *rect)
+{
+	LARGE_INTEGER begin, end;
+	QueryPerformanceCounter(&begin);
+	if (plugin->api.OnEvent)
+		plugin->api.OnEvent(event);
+	if (plugin->api.AdjustRect && event->kind == GRAPPLE_EVENT_MOTION)
+		plugin->api.AdjustRect(event, rect);
+	QueryPerformanceCounter(&end);
+
+	if (end.QuadPart - begin.QuadPart > budgetTicks) {
+		plugin->skippedGesture = gestureCount;
+		if (++plugin->overruns >= MAX_OVERRUNS)
+			plugin->isDisabled = true;
+	}
+}
+
+bool SendPluginEvent(GrappleEventKind kind, GrappleGestureKind gesture,
+	HWND hwnd, const POINT pt, RECT *rect)
+{
+	if (!pluginCount || IsShedding())
+		return false;
+
+	if (kind == GRAPPLE_EVENT_BEGIN)
+		gestureCount++;
+	const GrappleEvent *event = WriteEvent(kind, gesture, hwnd, pt, rect);
+	const RECT proposed = *rect;
+	for (int i = 0; i < pluginCount; i++) {
+		LoadedPlugin *plugin = &plugins[i];
+		if (!plugin->isDisabled && plugin->skippedGesture != gestureCount)
+			Deliver(plugin, event, rect);
+	}
+	return !EqualRect(rect, &proposed);
+}
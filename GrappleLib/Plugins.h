@@ -0,0 +1,27 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Plugins.h
+** Loads plugins and broadcasts gesture events to them.
+*/
+
+#pragma once
+
+#include "GrapplePlugin.h"
+
+// Loads every DLL in the Plugins folder next to GrappleLib.dll, the first
+// time it's called in each process. Slow; don't call it mid-gesture.
+void LoadPlugins(void);
+
+// Loads one plugin. Returns false if it can't be loaded, or if its init
+// went over the budget, in which case it's never called.
+bool LoadPlugin(const TCHAR *path);
+
+// Broadcasts a gesture event to the plugins loaded so far. For MOTION
+// events, plugins may change *rect. Returns true if *rect was changed.
+bool SendPluginEvent(GrappleEventKind kind, GrappleGestureKind gesture,
+	HWND hwnd, const POINT pt, RECT *rect);
@@ -0,0 +1,125 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Predict.cpp
+** Pointer motion prediction for move and resize gestures.
+**
+** Even with a fast hook, a dragged window trails the cursor because the
+** application repaints a frame or two after we move it. We hide that by
+** moving the window to where the cursor is about to be. This is a plain
+** constant-velocity model: pointer samples are exact, so we only smooth the
+** velocity estimate, and we clamp how far ahead we're willing to guess.
+*/
+
+#include "stdafx.h"
+#include "Predict.h"
+#include <cmath>
+
+static const int DEFAULT_LEAD_MS = 16;
+static const int MAX_LEAD_MS = 100;
+
+// Velocity smoothing factor. Higher follows direction changes faster but
+// jitters more.
+static const double VELOCITY_SMOOTHING = 0.5;
+
+// Below this speed (pixels/second) we track the pointer exactly.
+static const double MIN_SPEED = 60.0;
+
+// Never place the window further than this from the real pointer.
+static const double MAX_LEAD_PIXELS = 48.0;
+
+// A gap longer than this between samples means the pointer stopped, so the
+// old velocity no longer means anything.
+static const double STALE_SAMPLE_SECONDS = 0.1;
+
+#pragma data_seg(".shared")
+static volatile LONG isPredictionEnabled = 0;
+static volatile LONG predictionLeadMs = DEFAULT_LEAD_MS;
+#pragma data_seg()
+
+static LONGLONG ticksPerSecond = 0;
+
+// Per-process gesture state. A gesture always happens on a single thread.
+static LONGLONG lastTime;
+static POINT lastPoint;
+static double vx, vy;
+
+void SetPredictionOptions(bool enable, int leadMs)
+{
+	if (leadMs > 0)
+		InterlockedExchange(&predictionLeadMs, (leadMs > MAX_LEAD_MS) ? MAX_LEAD_MS : leadMs);
+	InterlockedExchange(&isPredictionEnabled, enable ? 1 : 0);
+}
+
+bool IsPredictionEnabled(void)
+{
+	return isPredictionEnabled != 0;
+}
+
+LONGLONG GetPredictionTime(void)
+{
+	if (!ticksPerSecond) {
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		ticksPerSecond = frequency.QuadPart;
+	}
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return (LONGLONG)((double)now.QuadPart * 1000000.0 / (double)ticksPerSecond);
+}
+
+void ResetPrediction(const POINT pt, LONGLONG timeUs)
+{
+	lastTime = timeUs;
+	lastPoint = pt;
+	vx = vy = 0.0;
+}
+
+static LONG Round(double d)
+{
+	return (LONG)((d < 0.0) ? d - 0.5 : d + 0.5);
+}
+
+POINT PredictPoint(const POINT pt, LONGLONG timeUs)
+{
+	if (!isPredictionEnabled)
+		return pt;
+
+	const double dt = (timeUs - lastTime) / 1000000.0;
+	if (dt <= 0.0)
+		return pt;
+
+	if (dt > STALE_SAMPLE_SECONDS) {
+		vx = vy = 0.0;
+	} else {
+		const double ix = (pt.x - lastPoint.x) / dt;
+		const double iy = (pt.y - lastPoint.y) / dt;
+		vx += VELOCITY_SMOOTHING * (ix - vx);
+		vy += VELOCITY_SMOOTHING * (iy - vy);
+	}
+	lastTime = timeUs;
+	lastPoint = pt;
+
+	const double speedSquared = vx * vx + vy * vy;
+	if (speedSquared < MIN_SPEED * MIN_SPEED)
+		return pt;
+
+	const double lead = predictionLeadMs / 1000.0;
+	double dx = vx * lead;
+	double dy = vy * lead;
+	const double distSquared = dx * dx + dy * dy;
+	if (distSquared > MAX_LEAD_PIXELS * MAX_LEAD_PIXELS) {
+		const double scale = MAX_LEAD_PIXELS / sqrt(distSquared);
+		dx *= scale;
+		dy *= scale;
+	}
+
+	POINT predicted;
+	predicted.x = pt.x + Round(dx);
+	predicted.y = pt.y + Round(dy);
+	return predicted;
+}
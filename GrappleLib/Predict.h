@@ -0,0 +1,30 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Predict.h
+** Pointer motion prediction for move and resize gestures.
+*/
+
+#pragma once
+
+// Turns prediction on or off for every hooked process, and sets how far ahead
+// (in milliseconds) to place the window. Zero keeps the current lead time.
+void SetPredictionOptions(bool enable, int leadMs);
+
+bool IsPredictionEnabled(void);
+
+// Sample times are in microseconds, on any clock that never runs backwards.
+// This is the one the hooks use.
+LONGLONG GetPredictionTime(void);
+
+// Start predicting from scratch at the beginning of a gesture.
+void ResetPrediction(const POINT pt, LONGLONG timeUs);
+
+// Feed in the latest pointer sample, taken at timeUs, and get back where we
+// expect the pointer to be once the target window gets around to repainting.
+// Returns pt itself when prediction is off or the pointer is (nearly) at rest.
+POINT PredictPoint(const POINT pt, LONGLONG timeUs);
@@ -0,0 +1,132 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Restore.cpp
+** Puts new windows where their application's windows were last put.
+**
+** Grapple.exe keeps the table (see Grapple/Geometry.cpp), but from outside
+** the application the earliest it can act is when a new window has already
+** been shown, so the window can be seen jumping, and the application may
+** have moved it again by then. Instead a CBT hook runs inside the
+** application while the window is being created and changes the position
+** and size it's created with, so it's never shown anywhere else. Each
+** process maps a read-only view of the table the first time it needs one.
+**
+** Maximizing can't be done this way, so Grapple.exe still does that when the
+** window is first shown.
+*/
+
+#include "stdafx.h"
+#include "Restore.h"
+#include "GeometryTable.h"
+
+#pragma data_seg(".shared")
+static DWORD ownerProcess = 0;
+#pragma data_seg()
+
+static HHOOK cbtHook = NULL;
+static HANDLE tableMapping = NULL;
+static const GeometryTable *table = NULL;
+
+static bool OpenTable(void)
+{
+	if (table)
+		return true;
+	tableMapping = OpenFileMapping(FILE_MAP_READ, FALSE, GEOMETRY_MAPPING);
+	if (!tableMapping)
+		return false;
+	table = (const GeometryTable *)MapViewOfFile(tableMapping, FILE_MAP_READ,
+		0, 0, sizeof(GeometryTable));
+	if (!table || table->magic != GEOMETRY_MAGIC || table->version != GEOMETRY_VERSION
+		|| table->capacity != GEOMETRY_CAPACITY) {
+		CloseRestore();
+		return false;
+	}
+	return true;
+}
+
+// Same kind of window Grapple.exe remembers: top-level, unowned and with a
+// caption. Windows the application asked to be created maximized or
+// minimized are left alone.
+static bool IsRestorable(const CREATESTRUCT *cs)
+{
+	return !cs->hwndParent && (cs->style & WS_CAPTION) == WS_CAPTION
+		&& !(cs->style & (WS_CHILD | WS_MAXIMIZE | WS_MINIMIZE))
+		&& !(cs->dwExStyle & WS_EX_TOOLWINDOW);
+}
+
+static void RestoreCreatedWindow(HWND hwnd, CREATESTRUCT *cs)
+{
+	if (!IsRestorable(cs) || !OpenTable())
+		return;
+	TCHAR path[MAX_PATH];
+	TCHAR className[256];
+	if (!GetModuleFileName(NULL, path, MAX_PATH) || !GetClassName(hwnd, className, 256))
+		return;
+	GeometryEntry entry;
+	if (!ReadGeometryEntry(table, GetGeometryKey(path, className), &entry))
+		return;
+	RECT rect = entry.rect;
+	if (IsRectEmpty(&rect))
+		return;
+
+	// Don't put windows back on a monitor that isn't there any more.
+	MONITORINFO info;
+	info.cbSize = sizeof(MONITORINFO);
+	const HMONITOR monitor = MonitorFromRect(&rect, MONITOR_DEFAULTTONULL);
+	if (!monitor || !GetMonitorInfo(monitor, &info))
+		return;
+
+	// The table has workspace coordinates, which start at the work area
+	// rather than the monitor. CREATESTRUCT wants screen coordinates.
+	OffsetRect(&rect, info.rcWork.left - info.rcMonitor.left,
+		info.rcWork.top - info.rcMonitor.top);
+	cs->x = rect.left;
+	cs->y = rect.top;
+
+	// Windows that can't be resized keep their own size.
+	if (cs->style & WS_THICKFRAME) {
+		cs->cx = rect.right - rect.left;
+		cs->cy = rect.bottom - rect.top;
+	}
+}
+
+static LRESULT CALLBACK CbtProc(int code, WPARAM wParam, LPARAM lParam)
+{
+	if (code == HCBT_CREATEWND && GetCurrentProcessId() != ownerProcess)
+		RestoreCreatedWindow((HWND)wParam, ((CBT_CREATEWND *)lParam)->lpcs);
+	return CallNextHookEx(cbtHook, code, wParam, lParam);
+}
+
+bool StartRestore(HINSTANCE module)
+{
+	if (!cbtHook) {
+		ownerProcess = GetCurrentProcessId();
+		cbtHook = SetWindowsHookEx(WH_CBT, CbtProc, module, 0);
+	}
+	return cbtHook != NULL;
+}
+
+void StopRestore(void)
+{
+	if (cbtHook) {
+		UnhookWindowsHookEx(cbtHook);
+		cbtHook = NULL;
+	}
+}
+
+void CloseRestore(void)
+{
+	if (table) {
+		UnmapViewOfFile(table);
+		table = NULL;
+	}
+	if (tableMapping) {
+		CloseHandle(tableMapping);
+		tableMapping = NULL;
+	}
+}
@@ -0,0 +1,21 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Restore.h
+** Puts new windows where their application's windows were last put.
+*/
+
+#pragma once
+
+// Installs or removes the global CBT hook that moves new windows into their
+// remembered place. Only Grapple.exe, which owns the table, calls these.
+// module is GrappleLib's own, where the hook procedure lives.
+bool StartRestore(HINSTANCE module);
+void StopRestore(void);
+
+// Lets go of this process's view of the table.
+void CloseRestore(void);
@@ -0,0 +1,162 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Reveal.cpp
+** Works out what comes into view when a window is sent to the back.
+**
+** We keep the part of the window's rectangle that's still hidden as a list of
+** disjoint rectangles. Windows above it stay on top, so whatever they cover
+** is taken out first. Then we go down the z-order: each window below gets
+** whatever part of the hidden area it overlaps, and that part is taken out
+** before moving on. Taking one rectangle out of another leaves at most four
+** pieces, and windows that miss the hidden area's bounding box are skipped
+** with four compares, so even hundreds of overlapping windows only take a
+** fraction of a frame. We stop as soon as nothing is left hidden.
+*/
+
+#include "stdafx.h"
+#include "Reveal.h"
+
+static const int MAX_REGION_RECTS = 4096;
+
+struct Region {
+	RECT rects[MAX_REGION_RECTS];
+	int count;
+};
+
+// Two regions to subtract back and forth between. Too big for the stack.
+static Region regions[2];
+
+static RECT GetTableRect(const WindowTable *table, int i)
+{
+	RECT r;
+	r.left = table->left[i];
+	r.top = table->top[i];
+	r.right = table->right[i];
+	r.bottom = table->bottom[i];
+	return r;
+}
+
+static bool Overlaps(const RECT *a, const RECT *b)
+{
+	return a->left < b->right && b->left < a->right && a->top < b->bottom && b->top < a->bottom;
+}
+
+static bool Append(Region *region, LONG left, LONG top, LONG right, LONG bottom)
+{
+	if (left >= right || top >= bottom)
+		return true;
+	if (region->count == MAX_REGION_RECTS)
+		return false;
+	RECT *r = &region->rects[region->count++];
+	r->left = left;
+	r->top = top;
+	r->right = right;
+	r->bottom = bottom;
+	return true;
+}
+
+// Puts the part of from not covered by cut into to. Returns false if to
+// ran out of room.
+static bool Subtract(const Region *from, const RECT *cut, Region *to)
+{
+	to->count = 0;
+	for (int i = 0; i < from->count; i++) {
+		const RECT *r = &from->rects[i];
+		if (!Overlaps(r, cut)) {
+			if (!Append(to, r->left, r->top, r->right, r->bottom))
+				return false;
+			continue;
+		}
+
+		// Full-width bands above and below the cut, then whatever is left
+		// beside it in between.
+		const LONG top = max(r->top, cut->top);
+		const LONG bottom = min(r->bottom, cut->bottom);
+		if (!Append(to, r->left, r->top, r->right, top) ||
+				!Append(to, r->left, bottom, r->right, r->bottom) ||
+				!Append(to, r->left, top, cut->left, bottom) ||
+				!Append(to, cut->right, top, r->right, bottom))
+			return false;
+	}
+	return true;
+}
+
+static void GetBounds(const Region *region, RECT *bounds)
+{
+	SetRectEmpty(bounds);
+	for (int i = 0; i < region->count; i++)
+		UnionRect(bounds, bounds, &region->rects[i]);
+}
+
+// Adds up the part of the region inside r, and its bounding box.
+static LONG Intersect(const Region *region, const RECT *r, RECT *bounds)
+{
+	LONG area = 0;
+	SetRectEmpty(bounds);
+	for (int i = 0; i < region->count; i++) {
+		RECT overlap;
+		if (IntersectRect(&overlap, &region->rects[i], r)) {
+			area += (overlap.right - overlap.left) * (overlap.bottom - overlap.top);
+			UnionRect(bounds, bounds, &overlap);
+		}
+	}
+	return area;
+}
+
+int ComputeReveal(const WindowTable *table, HWND hwnd, RevealedWindow *revealed, int limit)
+{
+	int self = -1;
+	for (int i = 0; i < table->count; i++) {
+		if (table->hwnd[i] == hwnd) {
+			self = i;
+			break;
+		}
+	}
+	if (self < 0)
+		return -1;
+
+	int current = 0;
+	Region *hidden = &regions[current];
+	hidden->count = 0;
+	const RECT selfRect = GetTableRect(table, self);
+	Append(hidden, selfRect.left, selfRect.top, selfRect.right, selfRect.bottom);
+
+	// Whatever is covered by windows in front stays covered.
+	for (int i = 0; i < self && hidden->count > 0; i++) {
+		const RECT r = GetTableRect(table, i);
+		if (!Overlaps(&r, &selfRect))
+			continue;
+		if (!Subtract(hidden, &r, &regions[1 - current]))
+			return -1;
+		current = 1 - current;
+		hidden = &regions[current];
+	}
+
+	RECT bounds;
+	GetBounds(hidden, &bounds);
+	int count = 0;
+	for (int i = self + 1; i < table->count && hidden->count > 0 && count < limit; i++) {
+		const RECT r = GetTableRect(table, i);
+		if (!Overlaps(&r, &bounds))
+			continue;
+
+		RevealedWindow *window = &revealed[count];
+		window->area = Intersect(hidden, &r, &window->bounds);
+		if (window->area == 0)
+			continue;
+		window->hwnd = table->hwnd[i];
+		count++;
+
+		if (!Subtract(hidden, &r, &regions[1 - current]))
+			return -1;
+		current = 1 - current;
+		hidden = &regions[current];
+		GetBounds(hidden, &bounds);
+	}
+	return count;
+}
@@ -0,0 +1,26 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Reveal.h
+** Works out what comes into view when a window is sent to the back.
+*/
+
+#pragma once
+
+#include "WindowTable.h"
+
+struct RevealedWindow {
+	HWND hwnd;
+	LONG area;       // Pixels that come into view.
+	RECT bounds;     // Bounding box of those pixels, in screen coordinates.
+};
+
+// Fills revealed with up to limit windows below hwnd in the table that would
+// come into view if hwnd were sent to the back, front to back. Returns how
+// many there are, or -1 if hwnd isn't in the table or the uncovered area got
+// too fragmented to keep track of.
+int ComputeReveal(const WindowTable *table, HWND hwnd, RevealedWindow *revealed, int limit);
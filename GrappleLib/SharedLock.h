@@ -0,0 +1,54 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** SharedLock.h
+** Lock for data in the shared data segment.
+**
+** The lists in the shared segment are only ever locked for the few
+** microseconds it takes to update or copy them, but they're locked from
+** hooks running in any process, and those can be preempted, starved by a
+** busy foreground, or killed outright while holding the lock. So nobody
+** waits long: TakeSharedLock() gives up after SHARED_LOCK_TIMEOUT_MS, and
+** callers skip whatever they were going to do. The lock word holds the tick
+** count it was taken at; one that's been held for SHARED_LOCK_ABANDONED_MS
+** can only belong to a holder that's gone, so it's taken over, and the data
+** it protects, which may be half-written, must be reset.
+*/
+
+#pragma once
+
+static const DWORD SHARED_LOCK_TIMEOUT_MS = 5;
+static const DWORD SHARED_LOCK_ABANDONED_MS = 1000;
+
+enum SharedLockResult {
+	SHARED_LOCK_BUSY = 0,        // Not taken.
+	SHARED_LOCK_TAKEN = 1,
+	SHARED_LOCK_ABANDONED = 2    // Taken from a holder that's gone. Reset the data.
+};
+
+inline SharedLockResult TakeSharedLock(volatile LONG *lock)
+{
+	const DWORD begin = GetTickCount();
+	for (;;) {
+		const DWORD now = GetTickCount();
+		const LONG stamp = (LONG)(now | 1);  // Never zero.
+		const LONG held = InterlockedCompareExchange(lock, stamp, 0);
+		if (!held)
+			return SHARED_LOCK_TAKEN;
+		if ((LONG)(now - (DWORD)held) > (LONG)SHARED_LOCK_ABANDONED_MS &&
+				InterlockedCompareExchange(lock, stamp, held) == held)
+			return SHARED_LOCK_ABANDONED;
+		if (now - begin >= SHARED_LOCK_TIMEOUT_MS)
+			return SHARED_LOCK_BUSY;
+		Sleep(0);
+	}
+}
+
+inline void ReleaseSharedLock(volatile LONG *lock)
+{
+	InterlockedExchange(lock, 0);
+}
@@ -0,0 +1,203 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Trace.cpp
+** Opt-in timeline tracing of hook and gesture work.
+**
+** Our hooks run inside every process on the desktop, so the trace buffer is
+** a named shared memory ring that Grapple.exe creates and each hooked process
+** maps lazily the first time it records a span while tracing is on. Every
+** span is a single fixed-size record (a Chrome "complete" event), so a ring
+** that wraps never leaves unmatched begin/end pairs behind. Recording costs
+** two QueryPerformanceCounter() calls and one interlocked increment; when
+** tracing is off it costs a single read of a shared flag.
+*/
+
+#include "stdafx.h"
+#include "Trace.h"
+#include <cstdio>
+
+static const TCHAR *TRACE_MAPPING_NAME = TEXT("Local\\GrappleTrace");
+
+// Must be a power of two.
+static const LONG TRACE_CAPACITY = 65536;
+
+static const char *TRACE_NAMES[TRACE_EVENT_COUNT] = {
+	"MouseProc",
+	"KbProc",
+	"ResolveWindow",
+	"Placement",
+	"EnumWindows",
+	"Prefetch",
+	"FirstMotion",
+	"FirstMotionPrefetched",
+	"Reveal",
+};
+
+struct TraceRecord {
+	LONGLONG begin;
+	LONGLONG end;
+	DWORD pid;
+	DWORD tid;
+	LONG event;
+
+	// Written last. Holds the record's ring index + 1 once the record is
+	// complete, so WriteTrace() can skip records that are mid-write or stale.
+	volatile LONG seq;
+};
+
+struct TraceBuffer {
+	volatile LONG next;
+	LONG reserved;
+	LONGLONG frequency;
+	TraceRecord records[TRACE_CAPACITY];
+};
+
+// Visible to every process our DLL is loaded into.
+#pragma data_seg(".shared")
+static volatile LONG isTraceEnabled = 0;
+#pragma data_seg()
+
+// Per-process view of the shared trace buffer.
+static HANDLE traceMapping = NULL;
+static TraceBuffer *traceBuffer = NULL;
+static bool hasTriedOpen = false;
+
+static TraceBuffer *OpenTraceBuffer(void)
+{
+	if (traceBuffer || hasTriedOpen)
+		return traceBuffer;
+
+	// Only try once per process. If we can't open the mapping (say, because
+	// we're in a low-integrity process), we simply don't trace here.
+	hasTriedOpen = true;
+	traceMapping = OpenFileMapping(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, TRACE_MAPPING_NAME);
+	if (traceMapping) {
+		traceBuffer = (TraceBuffer *)MapViewOfFile(traceMapping,
+			FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(TraceBuffer));
+		if (!traceBuffer) {
+			CloseHandle(traceMapping);
+			traceMapping = NULL;
+		}
+	}
+	return traceBuffer;
+}
+
+LONGLONG TraceBegin(void)
+{
+	if (!isTraceEnabled)
+		return 0;
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+void TraceEnd(TraceEvent event, LONGLONG begin)
+{
+	TraceBuffer *buffer = OpenTraceBuffer();
+	if (!buffer)
+		return;
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+
+	const LONG index = InterlockedIncrement(&buffer->next) - 1;
+	TraceRecord *record = &buffer->records[index & (TRACE_CAPACITY - 1)];
+	record->seq = 0;
+	record->begin = begin;
+	record->end = now.QuadPart;
+	record->pid = GetCurrentProcessId();
+	record->tid = GetCurrentThreadId();
+	record->event = event;
+	record->seq = index + 1;
+}
+
+bool SetTracing(bool enable)
+{
+	if (enable && !traceBuffer) {
+		// Keep the mapping alive for as long as Grapple.exe runs, so that
+		// hooked processes and WriteTrace() can get at it after recording stops.
+		traceMapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+			0, sizeof(TraceBuffer), TRACE_MAPPING_NAME);
+		if (!traceMapping)
+			return false;
+		traceBuffer = (TraceBuffer *)MapViewOfFile(traceMapping,
+			FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(TraceBuffer));
+		if (!traceBuffer) {
+			CloseHandle(traceMapping);
+			traceMapping = NULL;
+			return false;
+		}
+		hasTriedOpen = true;
+
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		traceBuffer->frequency = frequency.QuadPart;
+	}
+
+	if (enable) {
+		// Start a fresh trace. Stale records can't be mistaken for new ones
+		// because their sequence numbers won't match once they're overwritten,
+		// and WriteTrace() never looks past the current write position.
+		InterlockedExchange(&traceBuffer->next, 0);
+	}
+	InterlockedExchange(&isTraceEnabled, enable ? 1 : 0);
+	return true;
+}
+
+bool WriteTrace(const TCHAR *path)
+{
+	const TraceBuffer *buffer = OpenTraceBuffer();
+	if (!buffer)
+		return false;
+
+	FILE *f;
+	if (_tfopen_s(&f, path, TEXT("wt")) != 0)
+		return false;
+
+	const LONG next = buffer->next;
+	const LONG first = (next > TRACE_CAPACITY) ? next - TRACE_CAPACITY : 0;
+	const double usPerTick = 1000000.0 / (double)buffer->frequency;
+
+	fprintf(f, "{\"traceEvents\":[\n");
+	bool isFirst = true;
+	for (LONG i = first; i < next; i++) {
+		const TraceRecord *slot = &buffer->records[i & (TRACE_CAPACITY - 1)];
+		const TraceRecord record = *slot;
+
+		// Skip anything that was overwritten or half-written while we copied it.
+		if (record.seq != i + 1 || slot->seq != i + 1)
+			continue;
+		if (record.event < 0 || record.event >= TRACE_EVENT_COUNT)
+			continue;
+
+		fprintf(f, "%s{\"name\":\"%s\",\"cat\":\"grapple\",\"ph\":\"X\","
+			"\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lu,\"tid\":%lu}",
+			isFirst ? "" : ",\n",
+			TRACE_NAMES[record.event],
+			record.begin * usPerTick,
+			(record.end - record.begin) * usPerTick,
+			record.pid, record.tid);
+		isFirst = false;
+	}
+	fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(f);
+	return true;
+}
+
+void CloseTrace(void)
+{
+	if (traceBuffer) {
+		UnmapViewOfFile(traceBuffer);
+		traceBuffer = NULL;
+	}
+	if (traceMapping) {
+		CloseHandle(traceMapping);
+		traceMapping = NULL;
+	}
+}
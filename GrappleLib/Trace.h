@@ -0,0 +1,59 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** Trace.h
+** Opt-in timeline tracing of hook and gesture work.
+*/
+
+#pragma once
+
+// Kinds of spans we record. Keep TRACE_NAMES in Trace.cpp in sync with this list.
+enum TraceEvent {
+	TRACE_MOUSEPROC,
+	TRACE_KBPROC,
+	TRACE_RESOLVE,
+	TRACE_PLACEMENT,
+	TRACE_ENUMERATE,
+	TRACE_PREFETCH,
+	TRACE_FIRSTMOTION,
+	TRACE_FIRSTMOTION_PREFETCHED,
+	TRACE_REVEAL,
+	TRACE_EVENT_COUNT
+};
+
+// Returns a timestamp to pass to TraceEnd(), or 0 if tracing is off.
+LONGLONG TraceBegin(void);
+
+// Records a completed span that started at the given TraceBegin() timestamp.
+void TraceEnd(TraceEvent event, LONGLONG begin);
+
+// Starts or stops recording across all hooked processes. Only Grapple.exe
+// should call this, since it owns the trace buffer.
+bool SetTracing(bool enable);
+
+// Writes everything in the trace buffer out as Chrome trace-event JSON.
+bool WriteTrace(const TCHAR *path);
+
+// Releases this process's view of the trace buffer. Call on DLL detach.
+void CloseTrace(void);
+
+// Records a span covering the lifetime of the object.
+class TraceSpan {
+public:
+	explicit TraceSpan(TraceEvent event) : event(event), begin(TraceBegin()) {}
+	~TraceSpan() { if (begin) TraceEnd(event, begin); }
+
+	// When the span started, or 0 if tracing is off.
+	LONGLONG GetBegin() const { return begin; }
+
+private:
+	const TraceEvent event;
+	const LONGLONG begin;
+
+	TraceSpan(const TraceSpan &);
+	TraceSpan &operator=(const TraceSpan &);
+};
@@ -0,0 +1,262 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** WindowTable.cpp
+** Z-ordered snapshot of top-level window rectangles.
+**
+** MOUSEHOOKSTRUCT hands us the window under the cursor, but other code paths
+** (and anything working with positions rather than messages) need to answer
+** "which window is at this point" themselves. Asking the system per query
+** means a WindowFromPoint() plus a walk up the parent chain. Instead we take
+** one EnumWindows() snapshot and answer queries against it with a vector
+** scan: AVX2 when the build allows it, SSE2 otherwise, and plain C++ when
+** neither is available.
+**
+** The snapshot is the expensive part, so each process keeps its own until
+** something changes. Grapple.exe listens for top-level windows being shown,
+** hidden, moved, minimized, restored, activated or reordered, and bumps a
+** shared generation count that every process compares its table against.
+** Those events arrive some time after the change, so our own gestures that
+** reorder windows invalidate the tables themselves straight away.
+**
+** The generation count only ever goes up, even across the hooks being
+** reinstalled, so a table built before then can never look current after.
+*/
+
+#include "stdafx.h"
+#include "WindowTable.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TABLE_AVX2
+static const int TABLE_LANES = 8;
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TABLE_SSE2
+static const int TABLE_LANES = 4;
+#else
+static const int TABLE_LANES = 1;
+#endif
+
+// Tables are never reused while nobody is watching for changes.
+#pragma data_seg(".shared")
+static volatile LONG tableGeneration = 0;
+static volatile LONG isTableWatched = 0;
+#pragma data_seg()
+
+// The table is big, so it lives in this process's .bss, not on the stack.
+// Pages are only touched as far as the windows actually on the desktop.
+static WindowTable windowTable;
+static LONG builtGeneration = 0;
+static bool isTableBuilt = false;
+
+struct TableEventRange {
+	DWORD first;
+	DWORD last;
+};
+
+static const TableEventRange TABLE_EVENTS[] = {
+	{ EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND },
+	{ EVENT_SYSTEM_MINIMIZESTART, EVENT_SYSTEM_MINIMIZEEND },
+	{ EVENT_OBJECT_SHOW, EVENT_OBJECT_HIDE },
+	{ EVENT_OBJECT_REORDER, EVENT_OBJECT_REORDER },
+	{ EVENT_OBJECT_LOCATIONCHANGE, EVENT_OBJECT_LOCATIONCHANGE },
+};
+static const int TABLE_EVENT_COUNT = sizeof(TABLE_EVENTS) / sizeof(TABLE_EVENTS[0]);
+
+// Only used in Grapple.exe.
+static HWINEVENTHOOK tableHooks[TABLE_EVENT_COUNT] = { NULL };
+
+void ResetWindowTable(WindowTable *table)
+{
+	table->count = 0;
+}
+
+bool AddTableWindow(WindowTable *table, HWND hwnd, const RECT *r)
+{
+	// Leave room to pad the last vector.
+	const int n = table->count;
+	if (n + TABLE_LANES > MAX_TABLE_WINDOWS)
+		return false;
+
+	table->left[n] = r->left;
+	table->top[n] = r->top;
+	table->right[n] = r->right;
+	table->bottom[n] = r->bottom;
+	table->hwnd[n] = hwnd;
+	table->count = n + 1;
+
+	// Pad out to a whole vector with empty rectangles, which can't contain
+	// anything. The next call overwrites the padding.
+	for (int i = n + 1; i < MAX_TABLE_WINDOWS && (i % TABLE_LANES) != 0; i++) {
+		table->left[i] = table->right[i] = 0;
+		table->top[i] = table->bottom[i] = 0;
+		table->hwnd[i] = NULL;
+	}
+	return true;
+}
+
+static BOOL WINAPI CALLBACK AddWindowProc(HWND hwnd, LPARAM lParam)
+{
+	WindowTable *table = (WindowTable *)lParam;
+	if (!IsWindowVisible(hwnd) || IsIconic(hwnd))
+		return TRUE;
+
+	// Click-through windows (overlays and the like) are never hit.
+	const int exStyle = GetWindowLong(hwnd, GWL_EXSTYLE);
+	if ((exStyle & WS_EX_TRANSPARENT) != 0)
+		return TRUE;
+
+	RECT r;
+	if (!GetWindowRect(hwnd, &r) || r.left >= r.right || r.top >= r.bottom)
+		return TRUE;
+
+	return AddTableWindow(table, hwnd, &r) ? TRUE : FALSE;
+}
+
+const WindowTable *RefreshWindowTable(void)
+{
+	// Read the generation first: a change that lands while we enumerate then
+	// just costs another rebuild next time.
+	builtGeneration = tableGeneration;
+	isTableBuilt = true;
+	ResetWindowTable(&windowTable);
+	EnumWindows(AddWindowProc, (LPARAM)&windowTable);
+	return &windowTable;
+}
+
+const WindowTable *GetWindowTable(void)
+{
+	if (!isTableWatched || !isTableBuilt || tableGeneration != builtGeneration)
+		return RefreshWindowTable();
+	return &windowTable;
+}
+
+void InvalidateWindowTables(void)
+{
+	InterlockedIncrement(&tableGeneration);
+}
+
+static void CALLBACK TableEventProc(HWINEVENTHOOK hook, DWORD event, HWND hwnd,
+	LONG idObject, LONG idChild, DWORD thread, DWORD time)
+{
+	if (!hwnd)
+		return;
+
+	// A reorder is reported for the window whose children changed order,
+	// which for top-level windows is the desktop. Some versions report it
+	// for the top-level window itself.
+	if (event == EVENT_OBJECT_REORDER) {
+		if (hwnd == GetDesktopWindow() || GetAncestor(hwnd, GA_PARENT) == GetDesktopWindow())
+			InvalidateWindowTables();
+		return;
+	}
+
+	// Child windows moving around inside their parents don't matter, and
+	// there are a lot of them.
+	if (idObject != OBJID_WINDOW || idChild != CHILDID_SELF)
+		return;
+	if (GetAncestor(hwnd, GA_PARENT) != GetDesktopWindow())
+		return;
+	InvalidateWindowTables();
+}
+
+bool StartWindowTableEvents(void)
+{
+	bool isWatching = true;
+	for (int i = 0; i < TABLE_EVENT_COUNT; i++) {
+		if (!tableHooks[i])
+			tableHooks[i] = SetWinEventHook(TABLE_EVENTS[i].first, TABLE_EVENTS[i].last,
+				NULL, TableEventProc, 0, 0, WINEVENT_OUTOFCONTEXT);
+		if (!tableHooks[i])
+			isWatching = false;
+	}
+
+	// Missing any of these would leave tables stale, so then don't reuse them.
+	// Anything could have changed while nobody was watching, so tables built
+	// before now are out of date.
+	if (isWatching) {
+		InvalidateWindowTables();
+		InterlockedExchange(&isTableWatched, 1);
+	} else {
+		StopWindowTableEvents();
+	}
+	return isWatching;
+}
+
+void StopWindowTableEvents(void)
+{
+	InterlockedExchange(&isTableWatched, 0);
+	for (int i = 0; i < TABLE_EVENT_COUNT; i++) {
+		if (tableHooks[i]) {
+			UnhookWinEvent(tableHooks[i]);
+			tableHooks[i] = NULL;
+		}
+	}
+}
+
+int HitTestWindowTableScalar(const WindowTable *table, const POINT pt)
+{
+	for (int i = 0; i < table->count; i++) {
+		if (pt.x >= table->left[i] && pt.x < table->right[i] &&
+				pt.y >= table->top[i] && pt.y < table->bottom[i])
+			return i;
+	}
+	return -1;
+}
+
+// Returns the index of the lowest set bit of a nonzero movemask result.
+static inline int FirstLane(int mask)
+{
+	int lane = 0;
+	while (!(mask & 1)) {
+		mask >>= 1;
+		lane++;
+	}
+	return lane;
+}
+
+int HitTestWindowTable(const WindowTable *table, const POINT pt)
+{
+#if defined(TABLE_AVX2)
+	const __m256i x = _mm256_set1_epi32(pt.x);
+	const __m256i y = _mm256_set1_epi32(pt.y);
+	for (int i = 0; i < table->count; i += TABLE_LANES) {
+		const __m256i l = _mm256_load_si256((const __m256i *)&table->left[i]);
+		const __m256i t = _mm256_load_si256((const __m256i *)&table->top[i]);
+		const __m256i r = _mm256_load_si256((const __m256i *)&table->right[i]);
+		const __m256i b = _mm256_load_si256((const __m256i *)&table->bottom[i]);
+
+		// Inside when !(left > x) && !(top > y) && right > x && bottom > y.
+		const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(l, x), _mm256_cmpgt_epi32(t, y));
+		const __m256i inside = _mm256_and_si256(_mm256_cmpgt_epi32(r, x), _mm256_cmpgt_epi32(b, y));
+		const int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(outside, inside)));
+		if (mask)
+			return i + FirstLane(mask);
+	}
+	return -1;
+#elif defined(TABLE_SSE2)
+	const __m128i x = _mm_set1_epi32(pt.x);
+	const __m128i y = _mm_set1_epi32(pt.y);
+	for (int i = 0; i < table->count; i += TABLE_LANES) {
+		const __m128i l = _mm_load_si128((const __m128i *)&table->left[i]);
+		const __m128i t = _mm_load_si128((const __m128i *)&table->top[i]);
+		const __m128i r = _mm_load_si128((const __m128i *)&table->right[i]);
+		const __m128i b = _mm_load_si128((const __m128i *)&table->bottom[i]);
+
+		// Inside when !(left > x) && !(top > y) && right > x && bottom > y.
+		const __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(l, x), _mm_cmpgt_epi32(t, y));
+		const __m128i inside = _mm_and_si128(_mm_cmpgt_epi32(r, x), _mm_cmpgt_epi32(b, y));
+		const int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_andnot_si128(outside, inside)));
+		if (mask)
+			return i + FirstLane(mask);
+	}
+	return -1;
+#else
+	return HitTestWindowTableScalar(table, pt);
+#endif
+}
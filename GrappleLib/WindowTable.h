@@ -0,0 +1,61 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** WindowTable.h
+** Z-ordered snapshot of top-level window rectangles.
+*/
+
+#pragma once
+
+static const int MAX_TABLE_WINDOWS = 10240;
+
+// Rectangles are kept as separate coordinate arrays (rather than an array of
+// RECTs) so a hit test can compare several windows per instruction. Entry 0
+// is the front-most window. Arrays are padded with empty rectangles up to a
+// multiple of the vector width, so scans never need a scalar tail.
+struct WindowTable {
+	__declspec(align(32)) LONG left[MAX_TABLE_WINDOWS];
+	__declspec(align(32)) LONG top[MAX_TABLE_WINDOWS];
+	__declspec(align(32)) LONG right[MAX_TABLE_WINDOWS];
+	__declspec(align(32)) LONG bottom[MAX_TABLE_WINDOWS];
+	HWND hwnd[MAX_TABLE_WINDOWS];
+	int count;
+};
+
+// Returns this process's table of the current desktop, front to back,
+// keeping only visible, non-minimized windows that take mouse input. The
+// table is only rebuilt when windows have changed since it was last built.
+const WindowTable *GetWindowTable(void);
+
+// Rebuilds this process's table whether or not anything has changed.
+const WindowTable *RefreshWindowTable(void);
+
+// Marks every process's table out of date. Call after changing the z-order
+// of a window without activating anything; the reorder event for that only
+// reaches Grapple.exe later.
+void InvalidateWindowTables(void);
+
+// Starts or stops watching for windows changing, which is what lets tables
+// be reused. Until this has been called, GetWindowTable() rebuilds the table
+// every time. These install out-of-context WinEvent hooks, so only
+// Grapple.exe (which has a message loop) calls them.
+bool StartWindowTableEvents(void);
+void StopWindowTableEvents(void);
+
+// Appends a rectangle to the back of a table. Used by RefreshWindowTable(),
+// and handy for filling tables with made-up layouts.
+bool AddTableWindow(WindowTable *table, HWND hwnd, const RECT *r);
+
+// Clears a table.
+void ResetWindowTable(WindowTable *table);
+
+// Returns the index of the front-most window containing pt, or -1.
+int HitTestWindowTable(const WindowTable *table, const POINT pt);
+
+// Same as HitTestWindowTable(), one window at a time. Kept as the reference
+// implementation and for comparison.
+int HitTestWindowTableScalar(const WindowTable *table, const POINT pt);
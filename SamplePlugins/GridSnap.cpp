@@ -0,0 +1,32 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** GridSnap.cpp
+** Sample plugin that keeps dragged windows on a 16 pixel grid.
+**
+** This is the plugin from the comment at the top of GrapplePlugin.h. To try
+** it, copy GridSnap.dll into a Plugins folder next to GrappleLib.dll.
+*/
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "../GrappleLib/GrapplePlugin.h"
+
+static const LONG GRID = 16;
+
+static void WINAPI Snap(const GrappleEvent *event, RECT *rect)
+{
+	const LONG dx = (rect->left + GRID / 2) / GRID * GRID - rect->left;
+	const LONG dy = (rect->top + GRID / 2) / GRID * GRID - rect->top;
+	OffsetRect(rect, dx, dy);
+}
+
+extern "C" BOOL WINAPI GrapplePluginInit(const GrappleEventRing *ring, GrapplePlugin *plugin)
+{
+	plugin->AdjustRect = Snap;
+	return TRUE;
+}
@@ -0,0 +1,32 @@
+/*
+** Grapple
+** Copyright (C) 2005-2010 Will Hui.
+**
+** Distributed under the terms of the MIT license.
+** See LICENSE file for details.
+**
+** SlowPlugin.cpp
+** Sample plugin that always goes over its budget.
+**
+** Every MOTION event takes four times GRAPPLE_PLUGIN_BUDGET_US, and then
+** nudges the window a pixel to the right so that callers can tell it was
+** called. GrappleBench's "plugins" check loads it to make sure a slow plugin
+** is skipped for the rest of the gesture and then disabled. Don't put it in
+** the Plugins folder; every process would stutter on its first few drags.
+*/
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "../GrappleLib/GrapplePlugin.h"
+
+static void WINAPI Dawdle(const GrappleEvent *event, RECT *rect)
+{
+	Sleep(GRAPPLE_PLUGIN_BUDGET_US * 4 / 1000);
+	OffsetRect(rect, 1, 0);
+}
+
+extern "C" BOOL WINAPI GrapplePluginInit(const GrappleEventRing *ring, GrapplePlugin *plugin)
+{
+	plugin->AdjustRect = Dawdle;
+	return TRUE;
+}